@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(__linux__)
+#define ECS_VIRTUAL_MEMORY_REGIONS 1
+#else
+#define ECS_VIRTUAL_MEMORY_REGIONS 0
+#endif
+
+namespace ecs
+{
+    /**
+     * @brief A contiguous range of address space reserved up front and committed as it grows.
+     *
+     * The region never moves: growing it only commits the pages following the used ones, so the
+     * addresses handed out stay valid and nothing is ever copied. With huge pages the region is aligned
+     * to the huge page size and the kernel is asked to back it with transparent huge pages, which cuts 
+     * the TLB misses of long linear scans.
+     * Regions are only available on Linux: elsewhere is_valid() is always false, and callers are expected 
+     * to fall back to regular heap allocations.
+     */
+    struct virtual_memory_region_t
+    {
+    public:
+        static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+        virtual_memory_region_t(const size_t reservedSize, const bool useHugePages);
+        virtual_memory_region_t(const virtual_memory_region_t& other) = delete;
+        ~virtual_memory_region_t();
+
+        virtual_memory_region_t& operator=(const virtual_memory_region_t& other) = delete;
+
+        /* Tells whether the address space could be reserved. */
+        inline bool is_valid() const { return m_data != nullptr; }
+        inline std::byte* data() const { return m_data; }
+
+        /* The number of bytes in use. */
+        inline size_t size() const { return m_size; }
+
+        /* The number of bytes the region can grow to. */
+        inline size_t capacity() const { return m_capacity; }
+
+        /**
+         * @brief Grows the used part of the region by size bytes, committing memory as needed.
+         *
+         * @return The address of the first new byte, or nullptr if the region can't grow that much.
+         */
+        std::byte* grow(const size_t size);
+
+        /**
+         * @brief Shrinks the used part of the region to size bytes, giving the pages past it back to the system.
+         */
+        void shrink(const size_t size);
+
+    private:
+        std::byte* m_data{nullptr};
+        size_t m_size{0};
+        size_t m_committedSize{0};
+        size_t m_capacity{0};
+
+        /* Memory is committed in multiples of this size: whole huge pages when they are used. */
+        size_t m_commitGranularity{0};
+    };
+}
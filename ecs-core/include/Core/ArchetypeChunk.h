@@ -0,0 +1,336 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <vector>
+#include "Types.h"
+#include "ComponentData.h"
+
+namespace ecs
+{
+    /**
+     * @brief Describes where the packed array of a single component lives inside an archetype chunk.
+     */
+    struct chunk_column_t
+    {
+        static constexpr size_t NO_ENABLE_MASK = 0;
+
+        component_id componentID{0};
+        size_t componentSize{0};
+        size_t alignment{alignof(std::max_align_t)};
+        size_t offset{0};
+        component_ops_t ops;
+
+        /* Offset of the bitmask telling which rows have the component enabled, for enableable components. 
+           Masks always come after the entity IDs, so no mask can start at offset 0. */
+        size_t enableMaskOffset{NO_ENABLE_MASK};
+
+        /* SoA components get one column per field, in consecutive columns with the same component ID: 
+           this is the index of the field stored in the column. */
+        uint16_t fieldIndex{0};
+
+        inline bool is_enableable() const { return enableMaskOffset != NO_ENABLE_MASK; }
+    };
+
+    /**
+     * @brief Memory layout shared by all the chunks of the same archetype.
+     *
+     * Every chunk stores up to rows_per_chunk() rows of each component of the archetype. The
+     * components of a row are not interleaved: each component has its own packed array (column)
+     * inside the chunk, and columns are laid out one after the other, sorted by component ID.
+     * The chunk starts with a dense array of the IDs of the entities owning each row, so that 
+     * the n-th entity ID always lines up with the n-th element of every column.
+     * Each column starts at an offset that is a multiple of the alignment of its component (and of 
+     * the cache line size, if padColumnsToCacheLine is set), and chunks are allocated with the 
+     * strictest of these alignments, so that column base pointers are always properly aligned.
+     * Enableable components also get a bitmask with one bit per row, stored after all the columns.
+     * Tag components have no column at all, unless they are enableable, in which case they get an empty 
+     * column only holding the bitmask.
+     * Components stored as a structure of arrays get one column per field instead, and column_index() 
+     * returns the column of their first field, which is also the one holding the bitmask.
+     */
+    struct chunk_layout_t
+    {
+    public:
+        chunk_layout_t() = default;
+        chunk_layout_t(const std::vector<component_data>& componentsData,
+            const size_t targetChunkSize = ARCHETYPE_CHUNK_SIZE, 
+            const bool padColumnsToCacheLine = PAD_COLUMNS_TO_CACHE_LINE);
+
+        inline size_t rows_per_chunk() const { return m_rowsPerChunk; }
+        inline size_t chunk_size() const { return m_chunkSize; }
+
+        /* The distance between two consecutive chunks allocated together, which keeps all of them aligned. */
+        inline size_t chunk_stride() const { return m_chunkStride; }
+        inline size_t alignment() const { return m_alignment; }
+        inline size_t num_columns() const { return m_columns.size(); }
+        inline const chunk_column_t& column(const size_t index) const { return m_columns[index]; }
+        inline const std::vector<chunk_column_t>& columns() const { return m_columns; }
+
+        /* Returns the number of 64-bit words of the enable bitmask of each enableable column. */
+        inline size_t num_enable_mask_words() const { return (m_rowsPerChunk + 63) / 64; }
+
+        /**
+         * @brief Returns a column without any storage, used to access tag components. All of its rows 
+         *        alias the beginning of the chunk, which is harmless since tags have no data.
+         */
+        static const chunk_column_t& tag_column();
+
+        /**
+         * @brief Returns the index of the column storing the given component, or num_columns() if 
+         *        there is no such column. Takes constant time: no search and no hashing.
+         */
+        inline size_t column_index(const component_id componentID) const
+        {
+            return componentID < m_columnIndices.size() ? m_columnIndices[componentID] : m_columns.size();
+        }
+
+    private:
+        std::vector<chunk_column_t> m_columns;
+
+        /* Maps each component ID up to the highest one of the layout to the index of its column. 
+           IDs without a column map to the number of columns. */
+        std::vector<uint16_t> m_columnIndices;
+        size_t m_rowsPerChunk{0};
+        size_t m_chunkSize{0};
+        size_t m_chunkStride{0};
+        size_t m_alignment{alignof(std::max_align_t)};
+    };
+
+    /**
+     * @brief Tells how many chunks an archetype allocates at once when it runs out of rows.
+     *
+     * Each allocation gets at least minChunksPerAllocation chunks, and growthFactor times the amount 
+     * of chunks already allocated by the archetype: a factor of 0 grows the archetype linearly, a factor
+     * of 1 doubles its capacity every time.
+     */
+    struct chunk_growth_policy_t
+    {
+        size_t minChunksPerAllocation{1};
+        float growthFactor{0.0f};
+
+        size_t get_num_chunks_to_allocate(const size_t numAllocatedChunks) const;
+    };
+
+    /**
+     * @brief Where archetypes get the memory of their chunks from.
+     */
+    enum class EChunkAllocator : unsigned char
+    {
+        /**
+         * @brief Each batch of chunks is a separate heap allocation.
+         */
+        Heap,
+
+        /**
+         * @brief Chunks are carved out of a virtual memory region backed by transparent huge pages, which
+         * grows in place: all the chunks of an archetype are contiguous and the TLB covers many more of them.
+         * Falls back to Heap where virtual memory regions are not available.
+         */
+        HugePages
+    };
+
+    /**
+     * @brief A fixed-size block of memory holding a slice of the rows of an archetype.
+     *
+     * Chunks never grow: when all the chunks of an archetype are full, new ones are allocated.
+     * This keeps the cost of adding rows steady and never copies already existing rows around.
+     * A chunk is only a view over memory owned by a chunk_block_t.
+     */
+    struct archetype_chunk_t
+    {
+    public:
+        archetype_chunk_t() = default;
+        explicit archetype_chunk_t(std::byte* data) : m_data(data) {}
+
+        /**
+         * @brief Returns the IDs of the entities stored in this chunk, in row order.
+         */
+        inline entity_id* entities() const
+        {
+            return reinterpret_cast<entity_id*>(m_data);
+        }
+
+        /**
+         * @brief Returns a pointer to the first element of the given column.
+         */
+        inline void* column_data(const chunk_column_t& column) const
+        {
+            void* data = m_data + column.offset;
+            assert(reinterpret_cast<uintptr_t>(data) % column.alignment == 0 && "Misaligned chunk column.");
+            return data;
+        }
+
+        /**
+         * @brief Returns a pointer to the component stored in the given column at the given row.
+         *
+         * @param column The column of the component.
+         * @param row The chunk-local index of the row.
+         */
+        inline void* get_component(const chunk_column_t& column, const size_t row) const
+        {
+            return m_data + column.offset + column.componentSize * row;
+        }
+
+        /**
+         * @brief Returns the enable bitmask of the given enableable column: bit i tells whether the 
+         *        component is enabled in row i.
+         */
+        inline uint64_t* enable_mask(const chunk_column_t& column) const
+        {
+            assert(column.is_enableable() && "The column has no enable mask.");
+            return reinterpret_cast<uint64_t*>(m_data + column.enableMaskOffset);
+        }
+
+        inline bool is_enabled(const chunk_column_t& column, const size_t row) const
+        {
+            return (enable_mask(column)[row / 64] >> (row % 64)) & 1;
+        }
+
+        inline void set_enabled(const chunk_column_t& column, const size_t row, const bool enabled) const
+        {
+            uint64_t& word = enable_mask(column)[row / 64];
+            const uint64_t bit = uint64_t(1) << (row % 64);
+            word = enabled ? (word | bit) : (word & ~bit);
+        }
+
+    private:
+        std::byte* m_data{nullptr};
+    };
+
+    /**
+     * @brief Calls function(row) for each of the first numRows rows of the chunk having all the components 
+     *        of the given enableable columns enabled, in ascending order. 
+     * 
+     * Enable masks are scanned one 64-bit word at a time, so disabled rows cost nothing but a few bit 
+     * operations. Without any enableable column, all the rows are visited.
+     */
+    template<typename RowFunction>
+    inline void for_each_enabled_row(const archetype_chunk_t& chunk, const size_t numRows, 
+        std::span<const chunk_column_t* const> enableableColumns, RowFunction&& function)
+    {
+        for_each_enabled_row(chunk, 0, numRows, enableableColumns, function);
+    }
+
+    /**
+     * @brief Calls function(row) like the other overload, for the rows in [firstRow, endRow) only.
+     */
+    template<typename RowFunction>
+    inline void for_each_enabled_row(const archetype_chunk_t& chunk, const size_t firstRow, const size_t endRow,
+        std::span<const chunk_column_t* const> enableableColumns, RowFunction&& function)
+    {
+        if (enableableColumns.empty())
+        {
+            for (size_t row = firstRow; row < endRow; ++row)
+            {
+                function(row);
+            }
+            return;
+        }
+
+        const size_t endWordIndex = (endRow + 63) / 64;
+        for (size_t wordIndex = firstRow / 64; wordIndex < endWordIndex; ++wordIndex)
+        {
+            uint64_t enabledRows = wordIndex + 1 < endWordIndex || endRow % 64 == 0 ? ~uint64_t(0) 
+                : (uint64_t(1) << (endRow % 64)) - 1;
+            if (wordIndex == firstRow / 64)
+            {
+                enabledRows &= ~uint64_t(0) << (firstRow % 64);
+            }
+
+            for (const chunk_column_t* column : enableableColumns)
+            {
+                enabledRows &= chunk.enable_mask(*column)[wordIndex];
+            }
+
+            while (enabledRows != 0)
+            {
+                function(wordIndex * 64 + static_cast<size_t>(std::countr_zero(enabledRows)));
+                enabledRows &= enabledRows - 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Calls function(firstRow, count) for each run of consecutive rows among the first numRows rows of 
+     *        the chunk having all the components of the given enableable columns enabled, in ascending order. 
+     *        Without any enableable column, the whole chunk is a single run.
+     */
+    template<typename RunFunction>
+    inline void for_each_enabled_run(const archetype_chunk_t& chunk, const size_t numRows, 
+        std::span<const chunk_column_t* const> enableableColumns, RunFunction&& function)
+    {
+        if (enableableColumns.empty())
+        {
+            if (numRows > 0)
+            {
+                function(size_t(0), numRows);
+            }
+            return;
+        }
+
+        size_t runStart = 0;
+        size_t runSize = 0;
+        for_each_enabled_row(chunk, numRows, enableableColumns, [&](const size_t row)
+        {
+            if (runSize > 0 && runStart + runSize != row)
+            {
+                function(runStart, runSize);
+                runSize = 0;
+            }
+
+            runStart = runSize == 0 ? row : runStart;
+            ++runSize;
+        });
+
+        if (runSize > 0)
+        {
+            function(runStart, runSize);
+        }
+    }
+
+    /**
+     * @brief A single allocation holding a run of consecutive chunks with the same layout.
+     */
+    struct chunk_block_t
+    {
+    public:
+        chunk_block_t(const chunk_layout_t& layout, const size_t numChunks);
+        chunk_block_t(const chunk_block_t& other) = delete;
+        chunk_block_t(chunk_block_t&& other) noexcept = default;
+        ~chunk_block_t() = default;
+
+        chunk_block_t& operator=(const chunk_block_t& other) = delete;
+        chunk_block_t& operator=(chunk_block_t&& other) noexcept = default;
+
+        inline size_t num_chunks() const { return m_numChunks; }
+
+        /**
+         * @brief Returns the chunk at the given index of the block.
+         */
+        inline archetype_chunk_t get_chunk(const size_t index) const
+        {
+            return archetype_chunk_t(m_data.get() + m_chunkStride * index);
+        }
+
+    private:
+        struct block_deleter
+        {
+            size_t alignment{alignof(std::max_align_t)};
+
+            void operator()(std::byte* data) const 
+            { 
+                ::operator delete[](data, std::align_val_t(alignment)); 
+            }
+        };
+
+        std::unique_ptr<std::byte[], block_deleter> m_data;
+        size_t m_numChunks{0};
+        size_t m_chunkStride{0};
+    };
+}
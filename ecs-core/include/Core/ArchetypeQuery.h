@@ -11,22 +11,31 @@
 
 namespace ecs
 {
-	template<typename... Components>
+	/**
+	 * @brief A query over the entities of a world. Its terms are plain components, which entities must have 
+	 * 		  and are handed out to the callbacks, and the filters With<...>, Without<...>, Optional<...>, 
+	 * 		  Changed<...> and Added<...>. Components only read by the callbacks should be declared const, 
+	 * 		  so that they don't count as changed.
+	 */
+	template<typename... Terms>
 	struct query : public query_base
 	{
 	public:
 		/** Type of the function that can be passed to the forEach() method. */
-		using iteration_function = std::function<void(EntityHandle, Components&...)>;
+		using iteration_function = typename query_iteration_function<typename query_terms<Terms...>::fetches>::type;
 
 		query() : query_base() {}
 		query(std::weak_ptr<World> world) : query_base(world) {}
 
 		/**
 		 * @brief Iterate over all entities that match the query and call the given function for each of them.
-		 * @param func The function to call for each entity that matches the query.
+		 * @param func The function to call for each entity that matches the query, taking the components, 
+		 * 		  optionally preceded by the EntityHandle of the entity. Any callable works: it is never wrapped 
+		 * 		  in a std::function, so that it can be inlined in the loop over the entities.
 		 * @note The actual query is performed here. Just building the query object doesn't perform any query.
 		 */
-		void forEach(iteration_function&& func)
+		template<typename Function>
+		void forEach(Function&& func)
 		{
 			if (m_world.expired())
 			{
@@ -35,10 +44,54 @@ namespace ecs
 
 			if (ArchetypesRegistry* archetypesRegistry = m_world.lock()->GetArchetypesRegistry().get())
 			{
-				if (ComponentsRegistry* componentsRegistry = m_world.lock()->GetComponentsRegistry().get())
-				{
-					archetypesRegistry->ForEachEntity(func);
-				}
+				archetypesRegistry->ForEachEntity<Terms...>(std::forward<Function>(func));
+			}
+		}
+
+		/**
+		 * @brief Iterate over all entities that match the query like forEach(), spreading them over the threads 
+		 * 		  of the world. See World::SetNumThreads().
+		 * @param func The function to call for each entity, as in forEach(). It is called concurrently from 
+		 * 		  several threads, and must only access the components it is handed. Changes made through the 
+		 * 		  EntityHandle are deferred, and applied in the same order as forEach() would once all the 
+		 * 		  entities have been visited. The EntityHandle must not be kept past the call.
+		 * @param grainSize The maximum number of entities a thread visits at once. 0 hands out whole chunks.
+		 * @throw std::logic_error if called from the function of another parallelForEach() of the same world.
+		 */
+		template<typename Function>
+		void parallelForEach(Function&& func, const size_t grainSize = 0)
+		{
+			if (m_world.expired())
+			{
+				throw std::runtime_error("Attempt to make a query with an invalid world.");
+			}
+
+			std::shared_ptr<World> world = m_world.lock();
+			if (ArchetypesRegistry* archetypesRegistry = world->GetArchetypesRegistry().get())
+			{
+				archetypesRegistry->ParallelForEachEntity<Terms...>(world->GetThreadPool(), 
+					std::forward<Function>(func), grainSize);
+			}
+		}
+
+		/**
+		 * @brief Iterate over contiguous runs of the entities that match the query, handing out a span per 
+		 * 		  component, so that systems can run their own vectorized loops over whole arrays.
+		 * @param func The function to call for each run, taking a std::span<const entity_id> followed by a 
+		 * 		  span for each component the query fetches. It must not change the structure of the world.
+		 * @throw std::logic_error if any of the components is stored in sparse sets.
+		 */
+		template<typename Function>
+		void forEachChunk(Function&& func)
+		{
+			if (m_world.expired())
+			{
+				throw std::runtime_error("Attempt to make a query with an invalid world.");
+			}
+
+			if (ArchetypesRegistry* archetypesRegistry = m_world.lock()->GetArchetypesRegistry().get())
+			{
+				archetypesRegistry->ForEachChunk<Terms...>(std::forward<Function>(func));
 			}
 		}
 
@@ -47,9 +100,9 @@ namespace ecs
 		 * @param world The world to make the query for.
 		 * @return The query.
 		 */
-		static query<Components...> MakeQuery(std::weak_ptr<World> world) noexcept
+		static query<Terms...> MakeQuery(std::weak_ptr<World> world) noexcept
 		{
-			return query<Components...>(world);
+			return query<Terms...>(world);
 		}
 	};
 }
\ No newline at end of file
@@ -8,16 +8,14 @@
 #include "Types.h"
 #include "ComponentsRegistry.h"
 #include "ComponentData.h"
-#include "PackedComponentArray.h"
-#include "Containers/rbtree.h"
-#include "Containers/SetPoolAllocator.h"
+#include "ComponentSignature.h"
 
 namespace ecs 
 {
     struct archetype 
     {
     public:
-        using Signature = pm_set<component_id, 128>;
+        using Signature = component_signature;
 
         archetype();
         archetype(std::initializer_list<component_id> signature);
@@ -77,13 +75,21 @@ namespace ecs
         inline auto begin() const { return m_componentIDs.begin(); }
         inline auto end() const { return m_componentIDs.end(); }
 
+        inline const Signature& get_signature() const { return m_componentIDs; }
+
+        /**
+         * @brief Tells whether this archetype has all the components of the given signature.
+         */
+        inline bool matches(const Signature& requiredComponents) const
+        {
+            return m_componentIDs.contains_all(requiredComponents);
+        }
+
         inline bool operator==(const archetype& other) const { return m_componentIDs == other.m_componentIDs; }
 
     private:
-        /*  an ordered set containing the unique IDs of the components making this
-            archetype. This set is used to compute the archetype's hash.
-            @todo find a way to have this container inline for better cache locality and
-            avoiding memory allocations.  */
+        /*  an inline bitset containing the unique IDs of the components making this
+            archetype. It caches the archetype's hash, so hashing an archetype is free. */
         Signature m_componentIDs;
     };
 }
@@ -95,13 +101,7 @@ namespace std
     {
         size_t operator()(const ecs::archetype& archetype) const
         {
-            size_t seed = archetype.get_num_components();
-            for (auto componentIt = archetype.begin(); componentIt != archetype.end(); ++componentIt)
-            {
-                seed ^= std::hash<ecs::component_id>{}(*componentIt) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-            }
-
-            return seed;
+            return archetype.get_signature().hash();
         }
     };
 }
\ No newline at end of file
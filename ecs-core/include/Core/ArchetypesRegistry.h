@@ -1,20 +1,34 @@
 #pragma once
 
 #include <unordered_map>
+#include <algorithm>
 #include <memory>
+#include <array>
 #include <functional>
+#include <span>
+#include <utility>
+#include <optional>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 #include "Types.h"
 #include "Entity.h"
 #include "Archetypes.h"
-#include "PackedComponentArray.h"
+#include "ArchetypeChunk.h"
 #include "ComponentsRegistry.h"
 #include "ComponentData.h"
+#include "SparseComponentSet.h"
+#include "SoAComponents.h"
+#include "QueryTypes.h"
 #include "IDGenerator.h"
 #include "BatchComponentActionProcessor.h"
+#include "ThreadPool.h"
 #include "Containers/PoolMemoryAllocator.h"
 #include "Containers/SetPoolAllocator.h"
 #include "Containers/DynamicBucketAllocators.h"
 #include "Containers/memory.h"
+#include "Containers/VirtualMemoryRegion.h"
 
 namespace ecs
 {
@@ -35,24 +49,86 @@ namespace ecs
         template<typename... Components>
         void AddEntity(entity_id entity)
         {
-            AddEntity(entity, { component_data(sizeof(Components), 
-                GetComponentsRegistry()->GetComponentID<Components>(), 8)...});
+            AddEntity(entity, { GetComponentsRegistry()->GetOrAddComponentData<Components>()...});
         }
 
+        /**
+         * @brief Adds all the given entities to the archetype made of the given components. The archetype 
+         *        is looked up once, and all the storage the entities need is allocated at once.
+         * 
+         * @param entities The IDs of the entities to add.
+         * @return The ID of the archetype the entities have been added to.
+         */
+        template<typename... Components>
+        archetype_id AddEntities(std::span<const entity_id> entities)
+        {
+            const std::initializer_list<component_data> componentsData = 
+            { 
+                GetComponentsRegistry()->GetOrAddComponentData<Components>()... 
+            };
+
+            const archetype_id archetypeID = AddEntitiesToArchetype(entities, archetype(componentsData));
+            AddSparseComponents(entities, componentsData);
+            return archetypeID;
+        }
+
+        /**
+         * @brief Adds all the given entities to the archetype made of the given components, then calls 
+         *        the initializer for each of them, in order.
+         * 
+         * @param entities The IDs of the entities to add.
+         * @param initializer A callable invoked as initializer(index, component_reference_t<Components>...), 
+         *                    where index is the position of the entity in the entities span.
+         * @return The ID of the archetype the entities have been added to.
+         */
+        template<typename... Components, typename InitializerFunction>
+        archetype_id AddEntities(std::span<const entity_id> entities, InitializerFunction&& initializer)
+        {
+            static_assert(sizeof...(Components) > 0, "Entities without components have nothing to initialize");
+
+            const archetype_id archetypeID = AddEntities<Components...>(entities);
+            const archetype_set& archetypeSet = m_archetypeSets[archetypeID];
+            InitializeRows<Components...>(archetypeSet, archetypeSet.get_num_entities() - entities.size(), 
+                entities.size(), initializer, std::index_sequence_for<Components...>());
+            return archetypeID;
+        }
+
+        /**
+         * @brief Returns the component of the entity: a reference, or a soa_ref for SoA components.
+         * 
+         * @throw std::out_of_range if the entity doesn't have the component.
+         */
         template<typename ComponentType>
-        ComponentType& GetComponent(entity_id entity)
+        component_reference_t<ComponentType> GetComponent(entity_id entity)
         {
-            return *static_cast<ComponentType*>(GetComponent(entity, GetComponentsRegistry()->GetComponentID<ComponentType>()));
+            const component_id componentID = GetComponentsRegistry()->GetComponentID<ComponentType>();
+            if constexpr (is_soa_component_v<ComponentType>)
+            {
+                typename soa_ref<ComponentType>::fields_array fields;
+                GetComponentFields(entity, componentID, fields);
+                return soa_ref<ComponentType>(fields);
+            }
+            else
+            {
+                return *static_cast<ComponentType*>(GetComponent(entity, componentID));
+            }
         }
 
         template<typename ComponentType>
         ComponentType* FindComponent(entity_id entity)
         {
+            static_assert(!is_soa_component_v<ComponentType>, "SoA components can only be accessed through GetComponent()");
             return static_cast<ComponentType*>(FindComponent(entity, GetComponentsRegistry()->GetComponentID<ComponentType>()));
         }
 
         void RemoveEntity(entity_id entity);
 
+        /**
+         * @brief Removes all the given entities at once. Entities are grouped by archetype, and each 
+         *        archetype is compacted in a single pass. Unknown entities are ignored.
+         */
+        void RemoveEntities(std::span<const entity_id> entities);
+
         template<typename ComponentType>
         void AddComponent(entity_id entity)
         {
@@ -65,6 +141,34 @@ namespace ecs
             RemoveComponent(entity, GetComponentsRegistry()->GetComponentID<ComponentType>());
         }
 
+        /**
+         * @brief Enables or disables a component of the entity without removing it, so that queries skip 
+         *        the entity while the component is disabled. Takes constant time and never moves the entity.
+         * 
+         * @throw std::logic_error if the component has not been registered as enableable.
+         * @throw std::out_of_range if the entity doesn't have the component.
+         */
+        template<typename ComponentType>
+        void SetComponentEnabled(entity_id entity, const bool enabled)
+        {
+            SetComponentEnabled(entity, GetComponentsRegistry()->GetComponentID<ComponentType>(), enabled);
+        }
+
+        /**
+         * @brief Tells whether a component of the entity is enabled. Components which are not enableable 
+         *        are always enabled.
+         * 
+         * @throw std::out_of_range if the entity doesn't have the component.
+         */
+        template<typename ComponentType>
+        bool IsComponentEnabled(entity_id entity)
+        {
+            return IsComponentEnabled(entity, GetComponentsRegistry()->GetComponentID<ComponentType>());
+        }
+
+        void SetComponentEnabled(entity_id entity, const component_id componentID, const bool enabled);
+        bool IsComponentEnabled(entity_id entity, const component_id componentID) const;
+
         const archetype& GetArchetype(entity_id entity) const;
         archetype_id GetArchetypeID(entity_id entity) const;
         inline size_t GetNumEntitiesForArchetype(archetype_id archetypeID) const 
@@ -77,101 +181,1106 @@ namespace ecs
             return m_archetypeSets[archetypeID].get_num_entities();
         }
         
-        size_t GetNumArchetypes() const { return m_archetypeSets.size(); }
+        inline size_t GetNumChunksForArchetype(archetype_id archetypeID) const 
+        {
+            if (archetypeID >= m_archetypeSets.size())
+            {
+                return 0;
+            }
+
+            return m_archetypeSets[archetypeID].get_num_chunks();
+        }
+
+        /* Returns the number of entities the archetype can hold before allocating new chunks. */
+        inline size_t GetCapacityForArchetype(archetype_id archetypeID) const 
+        {
+            if (archetypeID >= m_archetypeSets.size())
+            {
+                return 0;
+            }
+
+            return m_archetypeSets[archetypeID].get_capacity();
+        }
+
+        /**
+         * @brief Makes room for at least numEntities entities in the archetype made of the given 
+         *        components, allocating all of its missing chunks at once.
+         * 
+         * @param numEntities The total number of entities the archetype should be able to hold.
+         * @return The ID of the archetype.
+         */
+        template<typename... Components>
+        archetype_id Reserve(const size_t numEntities)
+        {
+            const archetype_id archetypeID = GetOrCreateArchetypeID(
+                archetype({ GetComponentsRegistry()->GetOrAddComponentData<Components>()... }));
+            Reserve(archetypeID, numEntities);
+            return archetypeID;
+        }
+
+        void Reserve(archetype_id archetypeID, const size_t numEntities);
+
+        /**
+         * @brief Sets how many chunks archetypes allocate at once when they run out of rows. 
+         *        Applies to both existing and future archetypes.
+         */
+        void SetChunkGrowthPolicy(const chunk_growth_policy_t& growthPolicy);
+        inline const chunk_growth_policy_t& GetChunkGrowthPolicy() const { return m_chunkGrowthPolicy; }
+
+        /**
+         * @brief Sets where the chunks of the archetypes created from now on get their memory from. 
+         *        Existing archetypes keep their allocator.
+         */
+        inline void SetChunkAllocator(const EChunkAllocator chunkAllocator) { m_chunkAllocator = chunkAllocator; }
+        inline EChunkAllocator GetChunkAllocator() const { return m_chunkAllocator; }
+
+        size_t GetNumArchetypes() const { return m_archetypeSets.size() - m_retiredArchetypeIDs.size(); }
+
+        /**
+         * @brief Releases the memory the archetypes don't need anymore: chunks past the last used row are 
+         *        freed, and archetypes without entities are retired, so that queries stop visiting them. 
+         *        Sparse sets are shrunk to fit at the end of each pass.
+         * 
+         * The work is incremental: each call visits at most budget archetypes, resuming from where the
+         * previous call stopped.
+         * 
+         * @param budget The maximum number of archetypes to visit.
+         * @return true if this call completed a pass over all the archetypes.
+         */
+        bool Compact(const size_t budget = std::numeric_limits<size_t>::max());
         void Reset();
 
         /** 
-         * @brief Calls the provided function over all the entities that have the given components. 
+         * @brief Calls the provided function over all the entities matching the given query terms, skipping 
+         *        the ones having any of the required components disabled.
          * 
-         * @param function The function to call for each entity.
-         * @param components The components to query for.
+         * Terms are plain components, which entities must have and are fetched, and the filters With<...> 
+         * (must have, not fetched), Without<...> (must not have), Optional<...> (fetched if present), and
+         * Changed<...> and Added<...>, which skip the chunks not changed since the last run tick. Components 
+         * fetched as non-const mark the chunks they are visited in as changed.
+         * The function is a template parameter, so that it can be inlined in the loop over the rows: column 
+         * base pointers are resolved once per chunk, and rows are then fetched with plain indexed accesses.
+         * 
+         * @param function The function to call for each entity, as function(EntityHandle, Fetched...) 
+         *                 or function(Fetched...), with the fetched components in the order of the terms. 
+         *                 Components are passed by reference (soa_ref for SoA components), optional components 
+         *                 as component_pointer_t. Creating the handle of each entity has a cost, so functions 
+         *                 not needing it should not take it.
+         * @param terms The terms of the query.
          */
-        template<typename... Components>
-        void ForEachEntity(std::function<void(EntityHandle, Components&...)> function)
+        template<typename... Terms, typename Function>
+        void ForEachEntity(Function&& function)
         {
-            ArchetypesSet archetypes;
-            QueryArchetypes({ GetComponentsRegistry()->GetComponentID<Components>()... }, archetypes);
+            using terms = query_terms<Terms...>;
+            ForEachQueryEntity<std::tuple<Terms...>>(function, typename terms::fetches(), typename terms::with(), 
+                typename terms::without(), typename terms::change_filters());
+        }
 
-            std::shared_ptr<BatchComponentActionProcessor> batchComponentActionProcessor =
-                std::make_shared<BatchComponentActionProcessor>(m_world);
-            for (const archetype_id archetypeID : archetypes) 
-            {
-                const archetype_set& archetypeSet = m_archetypeSets[archetypeID];
-                const auto& indexMap = archetypeSet.index_map();
-                
-                // Only iterate over valid indices in the index map
-                for (const auto& [entityIndex, entityId] : indexMap)
-                {
-                    EntityHandle handle = EntityHandle(m_world, entityId, archetypeID, batchComponentActionProcessor);
-                    function(handle, *static_cast<Components*>(archetypeSet.get_component_at_index(GetComponentsRegistry()->GetComponentID<Components>(), entityIndex))...);
-                }
-            }
+        /** 
+         * @brief Calls the provided function over contiguous runs of the entities matching the given query 
+         *        terms: whole chunks, or the runs of consecutive rows having all the required components enabled.
+         * 
+         * @param function The function to call for each run, as function(std::span<const entity_id>, 
+         *                 std::span<Fetched>...): all the spans have the same size, and the n-th 
+         *                 component of each span belongs to the n-th entity. SoA components are passed as 
+         *                 soa_span. Optional components missing in the archetype get an empty span, and their
+         *                 enable state is ignored. Tags have no data, so their spans must not be read from.
+         *                 The function must not add or remove entities or components.
+         * @param terms The terms of the query, as in ForEachEntity().
+         * @throw std::logic_error if any of the components is stored in sparse sets, since they are not 
+         *        contiguous in the chunks.
+         */
+        template<typename... Terms, typename Function>
+        void ForEachChunk(Function&& function)
+        {
+            using terms = query_terms<Terms...>;
+            ForEachQueryChunk<std::tuple<Terms...>>(function, typename terms::fetches(), typename terms::with(), 
+                typename terms::without(), typename terms::change_filters());
+        }
 
-            batchComponentActionProcessor->ProcessActions();
+        /** 
+         * @brief Calls the provided function over all the entities matching the given query terms like 
+         *        ForEachEntity(), spreading them over the threads of the given pool.
+         * 
+         * Matched chunks are split into ranges of rows, which threads pick up as they go. The function is 
+         * called concurrently, so it must be safe to do so, and it must not access any component but the 
+         * ones it is handed. Handles defer structural changes to a buffer per range, and the buffers are 
+         * processed in range order once all the entities have been visited: the outcome is the same as 
+         * with ForEachEntity(), whatever the scheduling.
+         * 
+         * @param threadPool The threads to run the function on.
+         * @param function The function to call for each entity, as in ForEachEntity().
+         * @param grainSize The maximum number of rows in a range. 0 makes each chunk a single range.
+         * @throw std::logic_error if called from the function of another parallel pass over the same pool.
+         */
+        template<typename... Terms, typename Function>
+        void ParallelForEachEntity(ThreadPool& threadPool, Function&& function, const size_t grainSize = 0)
+        {
+            using terms = query_terms<Terms...>;
+            ParallelForEachQueryEntity<std::tuple<Terms...>>(threadPool, function, grainSize, 
+                typename terms::fetches(), typename terms::with(), typename terms::without(), 
+                typename terms::change_filters());
         }
 
         void QueryEntities(std::initializer_list<component_id> components, std::vector<entity_id>& entities);
 
+        /**
+         * @brief Returns the tick the changes to components are currently recorded at.
+         */
+        inline change_tick_t GetChangeTick() const { return m_changeTick; }
+
+        /**
+         * @brief Starts recording changes at the next tick. The world advances the tick after each system run,
+         *        so that the changes made by a system are newer than its own last run.
+         * @return The tick changes were recorded at until now.
+         */
+        inline change_tick_t AdvanceChangeTick() { return m_changeTick++; }
+
+        /**
+         * @brief Sets the tick the Changed<> and Added<> query filters compare with: chunks whose last change
+         *        happened at this tick or before are skipped. The world sets it to the last run tick of each 
+         *        system before running it, and back to 0 afterwards.
+         */
+        inline void SetLastRunTick(const change_tick_t lastRunTick) { m_lastRunTick = lastRunTick; }
+        inline change_tick_t GetLastRunTick() const { return m_lastRunTick; }
+
     private:
+        /* A cached transition from an archetype to the one obtained by adding or removing a single component. */
+        struct archetype_edge_t
+        {
+            component_id componentID{0};
+            archetype_id targetArchetypeID{INVALID_ARCHETYPE_ID};
+
+            /* For each column of the source archetype, the index of the column storing the same component
+               in the target archetype, or the number of target columns if the target doesn't have it. */
+            std::vector<size_t> columnMapping;
+        };
+
         struct archetype_set
         {
         public:
-            archetype_set();
-            archetype_set(const archetype& archetype, ComponentsRegistry* componentsRegistry);
-
-            /* Adds one element to each packed_component_array struct, returning the common index. */
-            size_t add_entity(entity_id entity);
-            size_t get_entity_index(entity_id entity) const;
-            size_t get_num_entities() const { return m_entityToIndexMap.size(); }
-            bool try_get_entity_index(entity_id entity, size_t& index) const;
+            /* Default-constructed sets have no layout: they only fill the slots of retired archetypes. */
+            archetype_set() = default;
+            archetype_set(const archetype& archetype, ComponentsRegistry* componentsRegistry,
+                const chunk_growth_policy_t& growthPolicy = chunk_growth_policy_t(), 
+                const EChunkAllocator chunkAllocator = EChunkAllocator::Heap);
+            archetype_set(const archetype_set& other) = delete;
+            archetype_set(archetype_set&& other) noexcept;
+            ~archetype_set();
+
+            archetype_set& operator=(const archetype_set& other) = delete;
+            archetype_set& operator=(archetype_set&& other) noexcept;
+
+            /* Tells whether this set fills the slot of a retired archetype. Every live archetype has a 
+               layout with at least one row per chunk. */
+            inline bool is_retired() const { return m_layout.rows_per_chunk() == 0; }
+
+            /* The last ticks the component of a column has been added and written at, in any row of a chunk. */
+            struct column_ticks_t
+            {
+                change_tick_t added{0};
+                change_tick_t changed{0};
+            };
+
+            /* Adds one row to the archetype, allocating a new chunk if all the existing ones are full,
+               and default-constructs its components, marking them as added at the given tick. 
+               Returns the index of the new row. */
+            size_t add_entity(entity_id entity, const change_tick_t tick);
+
+            /* Adds one row for each of the given entities, allocating all the missing chunks at once, and 
+               default-constructs their components one run per chunk, marking them as added at the given tick. 
+               Returns the index of the first new row. */
+            size_t add_entities(std::span<const entity_id> entities, const change_tick_t tick);
+            size_t get_num_entities() const { return m_numEntities; }
             void* get_component_at_index(const component_id componentID, const size_t index) const;
             void* find_component_at_index(const component_id componentID, const size_t index) const;
-            void remove_entity(entity_id entity);
-            void copy_entity_to(const entity_id entity, archetype_set& destination);
+
+            /* Swap-removes the row at the given index, moving the last row of the archetype in its place. 
+               The components of the removed row are destroyed, unless destroyComponents is false because
+               they have already been moved somewhere else.
+               Returns the ID of the moved entity, or INVALID_ENTITY_ID if no row was moved. */
+            entity_id remove_at(const size_t index, const bool destroyComponents = true);
+
+            /* Removes all the rows at the given indices, which must be sorted and unique, destroying their 
+               components. The holes left below the new number of rows are filled in a single pass with the
+               surviving rows at the end of the archetype, moving runs of consecutive rows at once. 
+               Holes are filled in ascending order, so that the rows that have been moved are exactly the 
+               given indices lower than get_num_entities(). */
+            void remove_rows(std::span<const size_t> sortedIndices);
+
+            /* Appends a row to the destination archetype, moving there all the components in common
+               with the row at the given index. Components missing in the destination are destroyed, and
+               components missing in the source are default-constructed: the source row is left without
+               any live component, ready for remove_at(index, false). The default-constructed components are
+               marked as added at the given tick. Returns the index of the new row in the destination. */
+            size_t move_entity_to(const size_t index, archetype_set& destination, 
+                const std::vector<size_t>& columnMapping, const change_tick_t tick);
+
+            /* Computes the column mapping used by move_entity_to() for moving rows to the destination. */
+            std::vector<size_t> make_column_mapping(const archetype_set& destination) const;
+
+            const archetype_edge_t* find_add_edge(const component_id componentID) const;
+            const archetype_edge_t* find_remove_edge(const component_id componentID) const;
+            const archetype_edge_t& set_add_edge(archetype_edge_t&& edge);
+            const archetype_edge_t& set_remove_edge(archetype_edge_t&& edge);
+            inline const std::vector<archetype_edge_t>& get_add_edges() const { return m_addEdges; }
+            inline const std::vector<archetype_edge_t>& get_remove_edges() const { return m_removeEdges; }
             inline const archetype& get_archetype() const { return m_archetype; }
-            inline const pm_unordered_map<entity_id, size_t, MAX_ENTITIES, MAX_ENTITIES>& entity_map() const 
+            entity_id get_entity_at_index(const size_t index) const;
+
+            inline const chunk_layout_t& get_layout() const { return m_layout; }
+            /* Returns the number of chunks holding at least one row. */
+            inline size_t get_num_chunks() const 
             { 
-                return m_entityToIndexMap; 
+                return (m_numEntities + m_layout.rows_per_chunk() - 1) / m_layout.rows_per_chunk(); 
             }
+            inline const archetype_chunk_t& get_chunk(const size_t chunkIndex) const { return m_chunks[chunkIndex]; }
+
+            /* Returns the number of rows the archetype can hold before allocating new chunks. */
+            inline size_t get_capacity() const { return m_chunks.size() * m_layout.rows_per_chunk(); }
+
+            /* Makes room for at least numEntities rows, allocating all the missing chunks at once. */
+            void reserve(const size_t numEntities);
+
+            inline void set_growth_policy(const chunk_growth_policy_t& growthPolicy) { m_growthPolicy = growthPolicy; }
+
+            /* Releases the chunks not holding any row. The used chunks of a partially used block are moved 
+               to a block of the right size. Returns the number of released chunks. */
+            size_t shrink_to_fit();
+
+            /* Forgets all the edges leading to the given archetype. */
+            void remove_edges_to(const archetype_id archetypeID);
+
+            /* Returns the number of rows actually used in the given chunk. */
+            size_t get_num_entities_in_chunk(const size_t chunkIndex) const;
 
-            inline const entity_id get_entity_at_index(const size_t index) const { return m_indexToEntityMap.at(index);}
-            inline const pm_unordered_map<size_t, entity_id, MAX_ENTITIES, MAX_ENTITIES>& index_map() const 
+            /* Returns the index of the column storing the given component, or the number of columns if
+               the archetype has no such component. */
+            inline size_t find_column_index(const component_id componentID) const 
             { 
-                return m_indexToEntityMap; 
+                return m_layout.column_index(componentID); 
             }
+
+            /* Returns the column storing the given component. Tag components, which have no storage, 
+               get chunk_layout_t::tag_column(). Throws std::out_of_range if the archetype has no such 
+               component. */
+            const chunk_column_t& get_column(const component_id componentID) const;
+
+            /* Returns the column storing the given component like get_column(), or nullptr if the archetype 
+               has no such component. */
+            const chunk_column_t* find_column(const component_id componentID) const;
+
+            /* Enables or disables the given component in the row at the given index. Throws std::logic_error
+               if the component is not enableable, and std::out_of_range if the archetype has no such component. */
+            void set_component_enabled(const component_id componentID, const size_t index, const bool enabled);
+
+            /* Tells whether the given component is enabled in the row at the given index. Components which
+               are not enableable are always enabled. */
+            bool is_component_enabled(const component_id componentID, const size_t index) const;
+
+            inline column_ticks_t& get_column_ticks(const size_t chunkIndex, const size_t columnIndex)
+            {
+                return m_columnTicks[chunkIndex * m_layout.num_columns() + columnIndex];
+            }
+
+            inline const column_ticks_t& get_column_ticks(const size_t chunkIndex, const size_t columnIndex) const
+            {
+                return m_columnTicks[chunkIndex * m_layout.num_columns() + columnIndex];
+            }
+
+            /* Marks the given component as written at the given tick in the chunk of the row at the given 
+               index. Tags have no data, so they are never marked. */
+            void mark_changed(const component_id componentID, const size_t index, const change_tick_t tick);
         
         private:
+            /* Destroys the components of all the rows. */
+            void destroy_rows();
+
+            /* Moves the first numRows rows of the source chunk to the uninitialized destination chunk. */
+            void relocate_chunk(const archetype_chunk_t& destination, const archetype_chunk_t& source, 
+                const size_t numRows) const;
+
+            /* Appends a row whose components are left uninitialized. */
+            size_t add_row(entity_id entity);
+
+            /* Allocates the given amount of contiguous chunks at once, growing the memory region in place if 
+               the archetype has one, or allocating a new block otherwise. */
+            void allocate_chunks(const size_t numChunks);
+
+            /* Moves count consecutive rows, which must not cross chunk boundaries, to the uninitialized 
+               destination rows. */
+            void move_rows(const size_t destinationIndex, const size_t sourceIndex, const size_t count);
+
+            /* Enables all the enableable components of count consecutive rows, which must not cross chunk 
+               boundaries. */
+            void enable_rows(const size_t firstIndex, const size_t count);
+
+            /* Marks all the components of the chunk of the row at the given index as added at the given tick. */
+            void mark_added(const size_t index, const change_tick_t tick);
+            void* get_component_in_column(const size_t columnIndex, const size_t index) const;
+
             archetype m_archetype;
-            pm_unordered_map<component_id, std::shared_ptr<packed_component_array_t>, 
-                MAX_COMPONENTS, MAX_COMPONENTS> m_componentArraysMap;
-            pm_unordered_map<entity_id, size_t, MAX_ENTITIES, MAX_ENTITIES> m_entityToIndexMap;
-            pm_unordered_map<size_t, entity_id, MAX_ENTITIES, MAX_ENTITIES> m_indexToEntityMap; //@todo replace this with a plain array for cache locality
+            chunk_layout_t m_layout;
+            chunk_growth_policy_t m_growthPolicy;
+
+            /* The region the first chunks are carved out of, with EChunkAllocator::HugePages. */
+            std::unique_ptr<virtual_memory_region_t> m_region;
+
+            /* The allocations owning the memory of the chunks which don't come from the region. Once the 
+               region is full, they hold all the following chunks. */
+            std::vector<chunk_block_t> m_blocks;
+
+            /* All the allocated chunks, in row order. Only the first get_num_chunks() hold rows. */
+            std::vector<archetype_chunk_t> m_chunks;
+            size_t m_numEntities = 0;
+
+            /* The change ticks of each column of each allocated chunk, chunk after chunk. Ticks are kept per 
+               chunk rather than per row, so that queries can skip unchanged chunks with a single comparison. */
+            std::vector<column_ticks_t> m_columnTicks;
+
+            /* Transitions to the archetypes reached by adding or removing one component. Archetypes
+               only have a handful of them, so a linear search is faster than any hash lookup. */
+            std::vector<archetype_edge_t> m_addEdges;
+            std::vector<archetype_edge_t> m_removeEdges;
         };
 
+        /* The archetypes matching a query, kept up to date as archetypes are created and retired, so that 
+           running the query again costs nothing but walking the vector. */
+        struct query_cache_t
+        {
+            archetype::Signature components;
+
+            /* Archetypes having any of these components never match. */
+            archetype::Signature excludedComponents;
+            std::vector<archetype_id> archetypes;
+
+            inline bool matches(const archetype& archetype) const
+            {
+                return archetype.matches(components) && !archetype.get_signature().intersects(excludedComponents);
+            }
+        };
+
+        using query_index_generator = TypeIndexGenerator<struct query_family>;
+
+        /* Returns the cache of the query identified by the given key type, creating it if needed. The 
+           components are only used the first time, and must always be the same for the same key. */
+        template<typename QueryKey>
+        const query_cache_t& GetOrCreateQueryCache(const archetype::Signature& components, 
+            const archetype::Signature& excludedComponents)
+        {
+            const size_t queryIndex = query_index_generator::GetTypeIndex<QueryKey>();
+            if (queryIndex >= m_queryCaches.size())
+            {
+                m_queryCaches.resize(queryIndex + 1);
+            }
+
+            if (m_queryCaches[queryIndex] == nullptr)
+            {
+                m_queryCaches[queryIndex] = CreateQueryCache(components, excludedComponents);
+            }
+
+            return *m_queryCaches[queryIndex];
+        }
+
+        std::unique_ptr<query_cache_t> CreateQueryCache(const archetype::Signature& components, 
+            const archetype::Signature& excludedComponents);
+
+        /* What a query resolves once per run: its cache, the sparse sets it has to check row by row, and the 
+           components whose change ticks it compares with the last run of its system. */
+        template<size_t NumFetches, size_t NumWith, size_t NumWithout, size_t NumChangeFilters>
+        struct query_context_t
+        {
+            const query_cache_t* cache{nullptr};
+            std::array<component_id, NumFetches> fetchIDs;
+            std::array<component_id, NumWith> withIDs;
+
+            /* The sparse set of each fetched component, or nullptr for the components stored in archetypes. */
+            std::array<const sparse_component_set_t*, NumFetches> fetchSparseSets;
+
+            /* The sparse sets entities must be in, and the ones they must not be in. */
+            std::array<const sparse_component_set_t*, NumWith> requiredSparseSets;
+            size_t numRequiredSparseSets{0};
+            std::array<const sparse_component_set_t*, NumWithout> excludedSparseSets;
+            size_t numExcludedSparseSets{0};
+
+            /* The components of the Changed<> and Added<> filters, and which of them are Added<> filters. */
+            std::array<component_id, NumChangeFilters> changeFilterIDs;
+            std::array<bool, NumChangeFilters> additionFilters;
+            change_tick_t lastRunTick{0};
+
+            inline bool has_sparse_components() const
+            {
+                return numRequiredSparseSets > 0 || numExcludedSparseSets > 0 
+                    || std::any_of(fetchSparseSets.begin(), fetchSparseSets.end(), 
+                        [](const sparse_component_set_t* sparseSet) { return sparseSet != nullptr; });
+            }
+        };
+
+        /* Splits the components of a query between the ones selecting the archetypes, and the ones stored in
+           sparse sets. */
+        template<typename QueryKey, typename... Fetches, typename... WithComponents, typename... WithoutComponents,
+            typename... ChangeFilters>
+        auto ResolveQuery(type_list<Fetches...>, type_list<WithComponents...>, type_list<WithoutComponents...>, 
+            type_list<ChangeFilters...>)
+        {
+            ComponentsRegistry* componentsRegistry = GetComponentsRegistry();
+            query_context_t<sizeof...(Fetches), sizeof...(WithComponents), sizeof...(WithoutComponents), 
+                sizeof...(ChangeFilters)> context;
+            context.fetchIDs = { componentsRegistry->GetComponentID<typename Fetches::component_type>()... };
+            context.withIDs = { componentsRegistry->GetComponentID<WithComponents>()... };
+            context.changeFilterIDs = { componentsRegistry->GetComponentID<typename ChangeFilters::component_type>()... };
+            context.additionFilters = { ChangeFilters::is_addition... };
+            context.lastRunTick = m_lastRunTick;
+            const std::array<component_id, sizeof...(WithoutComponents)> withoutIDs = 
+            { 
+                componentsRegistry->GetComponentID<WithoutComponents>()... 
+            };
+
+            // optional components don't select archetypes
+            constexpr std::array<bool, sizeof...(Fetches)> optionalFetches = { Fetches::is_optional... };
+            archetype::Signature components;
+            archetype::Signature excludedComponents;
+            for (size_t i = 0; i < context.fetchIDs.size(); ++i)
+            {
+                context.fetchSparseSets[i] = FindSparseSetForQuery(context.fetchIDs[i]);
+                if (context.fetchSparseSets[i] == nullptr && !optionalFetches[i])
+                {
+                    components.insert(context.fetchIDs[i]);
+                }
+            }
+
+            for (const component_id componentID : context.withIDs)
+            {
+                if (const sparse_component_set_t* sparseSet = FindSparseSetForQuery(componentID))
+                {
+                    context.requiredSparseSets[context.numRequiredSparseSets++] = sparseSet;
+                }
+                else
+                {
+                    components.insert(componentID);
+                }
+            }
+
+            for (const component_id componentID : withoutIDs)
+            {
+                if (const sparse_component_set_t* sparseSet = FindSparseSetForQuery(componentID))
+                {
+                    context.excludedSparseSets[context.numExcludedSparseSets++] = sparseSet;
+                }
+                else
+                {
+                    excludedComponents.insert(componentID);
+                }
+            }
+
+            // changes are tracked in chunks, so only the components stored in archetypes have them
+            for (const component_id componentID : context.changeFilterIDs)
+            {
+                if (FindSparseSetForQuery(componentID) != nullptr)
+                {
+                    throw std::logic_error("Changes to components stored in sparse sets are not tracked.");
+                }
+
+                components.insert(componentID);
+            }
+
+            context.cache = &GetOrCreateQueryCache<QueryKey>(components, excludedComponents);
+            return context;
+        }
+
+        /* Resolves the columns of the fetched components in the given archetype, which are nullptr for the 
+           components stored in sparse sets and for the optional components the archetype doesn't have, and 
+           collects the enableable columns of the required components. Returns the number of enableable columns. */
+        template<typename... Fetches, typename Context>
+        static size_t ResolveColumns(const archetype_set& archetypeSet, const Context& context,
+            std::array<const chunk_column_t*, sizeof...(Fetches)>& outColumns, 
+            std::span<const chunk_column_t*> outEnableableColumns)
+        {
+            constexpr std::array<bool, sizeof...(Fetches)> optionalFetches = { Fetches::is_optional... };
+            size_t numEnableableColumns = 0;
+            for (size_t i = 0; i < outColumns.size(); ++i)
+            {
+                outColumns[i] = context.fetchSparseSets[i] != nullptr ? nullptr : archetypeSet.find_column(context.fetchIDs[i]);
+                if (outColumns[i] != nullptr && outColumns[i]->is_enableable() && !optionalFetches[i])
+                {
+                    outEnableableColumns[numEnableableColumns++] = outColumns[i];
+                }
+            }
+
+            for (const component_id componentID : context.withIDs)
+            {
+                const chunk_column_t* column = archetypeSet.find_column(componentID);
+                if (column != nullptr && column->is_enableable())
+                {
+                    outEnableableColumns[numEnableableColumns++] = column;
+                }
+            }
+
+            return numEnableableColumns;
+        }
+
+        /* The columns of an archetype whose change ticks a query compares, and the ones it writes to. */
+        template<size_t NumFetches, size_t NumChangeFilters>
+        struct tick_columns_t
+        {
+            std::array<size_t, NumChangeFilters> filteredColumns;
+            std::array<size_t, NumFetches> writtenColumns;
+            size_t numWrittenColumns{0};
+        };
+
+        template<typename... Fetches, typename Context>
+        static auto ResolveTickColumns(const archetype_set& archetypeSet, const Context& context)
+        {
+            constexpr std::array<bool, sizeof...(Fetches)> readOnlyFetches = { Fetches::is_read_only... };
+            tick_columns_t<sizeof...(Fetches), std::tuple_size_v<decltype(context.changeFilterIDs)>> tickColumns;
+            for (size_t i = 0; i < tickColumns.filteredColumns.size(); ++i)
+            {
+                tickColumns.filteredColumns[i] = archetypeSet.find_column_index(context.changeFilterIDs[i]);
+            }
+
+            // tags, missing optional components and sparse components have no ticks to write
+            for (size_t i = 0; i < readOnlyFetches.size(); ++i)
+            {
+                const size_t columnIndex = archetypeSet.find_column_index(context.fetchIDs[i]);
+                if (!readOnlyFetches[i] && context.fetchSparseSets[i] == nullptr 
+                    && columnIndex < archetypeSet.get_layout().num_columns())
+                {
+                    tickColumns.writtenColumns[tickColumns.numWrittenColumns++] = columnIndex;
+                }
+            }
+
+            return tickColumns;
+        }
+
+        /* Tells whether the chunk passes the Changed<> and Added<> filters of the query, and if so marks the 
+           components the query writes to as changed in the whole chunk. */
+        template<typename Context, size_t NumFetches, size_t NumChangeFilters>
+        bool VisitChunkTicks(archetype_set& archetypeSet, const size_t chunkIndex, const Context& context,
+            const tick_columns_t<NumFetches, NumChangeFilters>& tickColumns) const
+        {
+            for (size_t i = 0; i < NumChangeFilters; ++i)
+            {
+                const archetype_set::column_ticks_t& ticks = archetypeSet.get_column_ticks(chunkIndex, 
+                    tickColumns.filteredColumns[i]);
+                if ((context.additionFilters[i] ? ticks.added : ticks.changed) <= context.lastRunTick)
+                {
+                    return false;
+                }
+            }
+
+            for (size_t i = 0; i < tickColumns.numWrittenColumns; ++i)
+            {
+                archetypeSet.get_column_ticks(chunkIndex, tickColumns.writtenColumns[i]).changed = m_changeTick;
+            }
+
+            return true;
+        }
+
+        template<typename QueryKey, typename... Fetches, typename... WithComponents, typename WithoutList, 
+            typename ChangeFilterList, typename Function>
+        void ForEachQueryEntity(Function& function, type_list<Fetches...> fetches, type_list<WithComponents...> with, 
+            WithoutList without, ChangeFilterList changeFilters)
+        {
+            constexpr bool passHandle = std::is_invocable_v<Function&, EntityHandle, typename Fetches::argument_type...>;
+            static_assert(passHandle || std::is_invocable_v<Function&, typename Fetches::argument_type...>, 
+                "The function must take the fetched components, optionally preceded by an EntityHandle");
+
+            const auto context = ResolveQuery<QueryKey>(fetches, with, without, changeFilters);
+            const bool hasSparseComponents = context.has_sparse_components();
+
+            // archetypes created by the callback itself are left out
+            const std::vector<archetype_id>& archetypes = context.cache->archetypes;
+            const size_t numArchetypes = archetypes.size();
+
+            // handles defer structural changes until all the entities have been visited
+            std::optional<BatchComponentActionProcessor> batchComponentActionProcessor;
+            if constexpr (passHandle)
+            {
+                batchComponentActionProcessor.emplace(m_world);
+            }
+
+            for (size_t archetypeIndex = 0; archetypeIndex < numArchetypes; ++archetypeIndex) 
+            {
+                const archetype_id archetypeID = archetypes[archetypeIndex];
+                archetype_set& archetypeSet = m_archetypeSets[archetypeID];
+
+                // columns are resolved once per archetype, so fetching components does no lookup at all
+                std::array<const chunk_column_t*, sizeof...(Fetches)> columns;
+                std::array<const chunk_column_t*, sizeof...(Fetches) + sizeof...(WithComponents)> enableableColumns;
+                const size_t numEnableableColumns = ResolveColumns<Fetches...>(archetypeSet, context, columns, 
+                    enableableColumns);
+                const auto tickColumns = ResolveTickColumns<Fetches...>(archetypeSet, context);
+                
+                // Rows are visited in storage order, one chunk after the other
+                const row_visit_context_t<sizeof...(Fetches)> rowContext
+                { 
+                    archetypeID, columns, context.fetchSparseSets, 
+                    std::span(context.requiredSparseSets.data(), context.numRequiredSparseSets),
+                    std::span(context.excludedSparseSets.data(), context.numExcludedSparseSets),
+                    std::span(enableableColumns.data(), numEnableableColumns), 
+                    batchComponentActionProcessor ? &*batchComponentActionProcessor : nullptr
+                };
+                for (size_t chunkIndex = 0; chunkIndex < archetypeSet.get_num_chunks(); ++chunkIndex)
+                {
+                    if (!VisitChunkTicks(archetypeSet, chunkIndex, context, tickColumns))
+                    {
+                        continue;
+                    }
+
+                    if (hasSparseComponents)
+                    {
+                        ForEachChunkRow<true, passHandle, Fetches...>(function, archetypeSet.get_chunk(chunkIndex), 
+                            0, archetypeSet.get_num_entities_in_chunk(chunkIndex), rowContext, 
+                            std::index_sequence_for<Fetches...>());
+                    }
+                    else
+                    {
+                        ForEachChunkRow<false, passHandle, Fetches...>(function, archetypeSet.get_chunk(chunkIndex), 
+                            0, archetypeSet.get_num_entities_in_chunk(chunkIndex), rowContext, 
+                            std::index_sequence_for<Fetches...>());
+                    }
+                }
+            }
+
+            if (batchComponentActionProcessor)
+            {
+                batchComponentActionProcessor->ProcessActions();
+            }
+        }
+
+        template<typename QueryKey, typename... Fetches, typename... WithComponents, typename WithoutList, 
+            typename ChangeFilterList, typename Function>
+        void ForEachQueryChunk(Function& function, type_list<Fetches...> fetches, type_list<WithComponents...> with, 
+            WithoutList without, ChangeFilterList changeFilters)
+        {
+            static_assert(std::is_invocable_v<Function&, std::span<const entity_id>, typename Fetches::span_type...>,
+                "The function must take the entities and a span for each fetched component");
+
+            const auto context = ResolveQuery<QueryKey>(fetches, with, without, changeFilters);
+            if (context.has_sparse_components())
+            {
+                throw std::logic_error("Components stored in sparse sets are not contiguous in chunks. Use ForEachEntity().");
+            }
+
+            for (const archetype_id archetypeID : context.cache->archetypes)
+            {
+                archetype_set& archetypeSet = m_archetypeSets[archetypeID];
+                std::array<const chunk_column_t*, sizeof...(Fetches)> columns;
+                std::array<const chunk_column_t*, sizeof...(Fetches) + sizeof...(WithComponents)> enableableColumns;
+                const size_t numEnableableColumns = ResolveColumns<Fetches...>(archetypeSet, context, columns, 
+                    enableableColumns);
+                const auto tickColumns = ResolveTickColumns<Fetches...>(archetypeSet, context);
+
+                for (size_t chunkIndex = 0; chunkIndex < archetypeSet.get_num_chunks(); ++chunkIndex)
+                {
+                    if (!VisitChunkTicks(archetypeSet, chunkIndex, context, tickColumns))
+                    {
+                        continue;
+                    }
+
+                    const archetype_chunk_t& chunk = archetypeSet.get_chunk(chunkIndex);
+                    for_each_enabled_run(chunk, archetypeSet.get_num_entities_in_chunk(chunkIndex), 
+                        std::span(enableableColumns.data(), numEnableableColumns), 
+                        [&](const size_t firstRow, const size_t count)
+                        {
+                            InvokeForRun<Fetches...>(function, chunk, firstRow, count, columns, 
+                                std::index_sequence_for<Fetches...>());
+                        });
+                }
+            }
+        }
+
+        /* The rows of a chunk a thread visits at once in a parallel query. */
+        struct row_range_t
+        {
+            size_t archetypeIndex{0};
+            size_t chunkIndex{0};
+            size_t firstRow{0};
+            size_t endRow{0};
+        };
+
+        template<typename QueryKey, typename... Fetches, typename... WithComponents, typename WithoutList, 
+            typename ChangeFilterList, typename Function>
+        void ParallelForEachQueryEntity(ThreadPool& threadPool, Function& function, const size_t grainSize, 
+            type_list<Fetches...> fetches, type_list<WithComponents...> with, WithoutList without, 
+            ChangeFilterList changeFilters)
+        {
+            constexpr bool passHandle = std::is_invocable_v<Function&, EntityHandle, typename Fetches::argument_type...>;
+            static_assert(passHandle || std::is_invocable_v<Function&, typename Fetches::argument_type...>, 
+                "The function must take the fetched components, optionally preceded by an EntityHandle");
+
+            const auto context = ResolveQuery<QueryKey>(fetches, with, without, changeFilters);
+            const bool hasSparseComponents = context.has_sparse_components();
+
+            // columns are resolved and change ticks updated up front, so that threads never write to the registry
+            struct archetype_visit_t
+            {
+                archetype_id archetypeID{INVALID_ARCHETYPE_ID};
+                std::array<const chunk_column_t*, sizeof...(Fetches)> columns;
+                std::array<const chunk_column_t*, sizeof...(Fetches) + sizeof...(WithComponents)> enableableColumns;
+                size_t numEnableableColumns{0};
+            };
+
+            std::vector<archetype_visit_t> archetypeVisits(context.cache->archetypes.size());
+            std::vector<row_range_t> ranges;
+            for (size_t archetypeIndex = 0; archetypeIndex < archetypeVisits.size(); ++archetypeIndex)
+            {
+                archetype_visit_t& visit = archetypeVisits[archetypeIndex];
+                visit.archetypeID = context.cache->archetypes[archetypeIndex];
+                archetype_set& archetypeSet = m_archetypeSets[visit.archetypeID];
+                visit.numEnableableColumns = ResolveColumns<Fetches...>(archetypeSet, context, visit.columns, 
+                    visit.enableableColumns);
+                const auto tickColumns = ResolveTickColumns<Fetches...>(archetypeSet, context);
+
+                const size_t rangeSize = grainSize > 0 ? grainSize : archetypeSet.get_layout().rows_per_chunk();
+                for (size_t chunkIndex = 0; chunkIndex < archetypeSet.get_num_chunks(); ++chunkIndex)
+                {
+                    if (!VisitChunkTicks(archetypeSet, chunkIndex, context, tickColumns))
+                    {
+                        continue;
+                    }
+
+                    const size_t numRows = archetypeSet.get_num_entities_in_chunk(chunkIndex);
+                    for (size_t firstRow = 0; firstRow < numRows; firstRow += rangeSize)
+                    {
+                        ranges.push_back({ archetypeIndex, chunkIndex, firstRow, std::min(firstRow + rangeSize, numRows) });
+                    }
+                }
+            }
+
+            // a buffer per range rather than per thread, so that the order of the changes doesn't depend on scheduling. 
+            // Buffers are stored by value, and only allocate memory once an action is deferred to them.
+            std::vector<BatchComponentActionProcessor> batchComponentActionProcessors(passHandle ? ranges.size() : 0, 
+                BatchComponentActionProcessor(m_world));
+            threadPool.ParallelFor(ranges.size(), [&](const size_t rangeIndex, const size_t /*threadIndex*/)
+            {
+                const row_range_t& range = ranges[rangeIndex];
+                const archetype_visit_t& visit = archetypeVisits[range.archetypeIndex];
+
+                const row_visit_context_t<sizeof...(Fetches)> rowContext
+                { 
+                    visit.archetypeID, visit.columns, context.fetchSparseSets, 
+                    std::span(context.requiredSparseSets.data(), context.numRequiredSparseSets),
+                    std::span(context.excludedSparseSets.data(), context.numExcludedSparseSets),
+                    std::span(visit.enableableColumns.data(), visit.numEnableableColumns), 
+                    passHandle ? &batchComponentActionProcessors[rangeIndex] : nullptr
+                };
+
+                const archetype_chunk_t& chunk = m_archetypeSets[visit.archetypeID].get_chunk(range.chunkIndex);
+                if (hasSparseComponents)
+                {
+                    ForEachChunkRow<true, passHandle, Fetches...>(function, chunk, range.firstRow, range.endRow, 
+                        rowContext, std::index_sequence_for<Fetches...>());
+                }
+                else
+                {
+                    ForEachChunkRow<false, passHandle, Fetches...>(function, chunk, range.firstRow, range.endRow, 
+                        rowContext, std::index_sequence_for<Fetches...>());
+                }
+            });
+
+            for (BatchComponentActionProcessor& batchComponentActionProcessor : batchComponentActionProcessors)
+            {
+                batchComponentActionProcessor.ProcessActions();
+            }
+        }
+
         void AddEntity(entity_id entity, std::initializer_list<component_data> componentTypes);
         void AddEntity(entity_id entity, const archetype& archetype);
+        archetype_id AddEntitiesToArchetype(std::span<const entity_id> entities, const archetype& archetype);
+
+        /* Adds to the given entities the components of the list which are stored in sparse sets. */
+        void AddSparseComponents(std::span<const entity_id> entities, std::initializer_list<component_data> componentsData);
+
+        /* What ForEachChunkRow() needs to know about the archetype being visited. */
+        template<size_t NumFetches>
+        struct row_visit_context_t
+        {
+            archetype_id archetypeID;
+
+            /* The column of each fetched component, or nullptr if the archetype doesn't store it. */
+            const std::array<const chunk_column_t*, NumFetches>& columns;
+            const std::array<const sparse_component_set_t*, NumFetches>& sparseSets;
+            std::span<const sparse_component_set_t* const> requiredSparseSets;
+            std::span<const sparse_component_set_t* const> excludedSparseSets;
+            std::span<const chunk_column_t* const> enableableColumns;
+
+            /* Borrowed by the handles passed to the function, so that visiting a row touches no reference count. */
+            BatchComponentActionProcessor* batchComponentActionProcessor;
+        };
+
+        /* Calls the function over the enabled rows of a chunk in [firstRow, endRow). Queries without sparse 
+           components don't check sparse sets at all, so that their loop is nothing but indexed accesses to 
+           the columns. */
+        template<bool HasSparseComponents, bool PassHandle, typename... Fetches, typename Function, size_t... Indices>
+        void ForEachChunkRow(Function& function, const archetype_chunk_t& chunk, const size_t firstRow, const size_t endRow,
+            const row_visit_context_t<sizeof...(Fetches)>& context, std::index_sequence<Indices...>)
+        {
+            std::array<std::byte*, sizeof...(Fetches)> columnsData;
+            for (size_t i = 0; i < columnsData.size(); ++i)
+            {
+                columnsData[i] = context.columns[i] != nullptr 
+                    ? static_cast<std::byte*>(chunk.column_data(*context.columns[i])) : nullptr;
+            }
+
+            const entity_id* entities = chunk.entities();
+            for_each_enabled_row(chunk, firstRow, endRow, context.enableableColumns, [&](const size_t row)
+            {
+                std::array<void*, sizeof...(Fetches)> sparseComponents{};
+                if constexpr (HasSparseComponents)
+                {
+                    constexpr std::array<bool, sizeof...(Fetches)> optionalFetches = { Fetches::is_optional... };
+                    if (!FindSparseComponents(entities[row], context.sparseSets, optionalFetches, sparseComponents)
+                        || !MatchesSparseSets(entities[row], context.requiredSparseSets, context.excludedSparseSets))
+                    {
+                        return;
+                    }
+                }
+
+                if constexpr (PassHandle)
+                {
+                    function(EntityHandle(m_world.get(), entities[row], context.archetypeID, 
+                        context.batchComponentActionProcessor),
+                        GetRowComponent<Fetches, HasSparseComponents>(chunk, row, context.columns[Indices], 
+                            columnsData[Indices], sparseComponents[Indices])...);
+                }
+                else
+                {
+                    function(GetRowComponent<Fetches, HasSparseComponents>(chunk, row, context.columns[Indices], 
+                        columnsData[Indices], sparseComponents[Indices])...);
+                }
+            });
+        }
+
+        /* Returns the component of the given row, taking it from the sparse component if any, or from the 
+           column otherwise. SoA components need all the columns of their fields, which follow the column of 
+           the first one. Optional components are null when missing or disabled. */
+        template<typename Fetch, bool HasSparseComponents>
+        static inline typename Fetch::argument_type GetRowComponent(const archetype_chunk_t& chunk, 
+            const size_t row, const chunk_column_t* column, std::byte* columnData, void* sparseComponent)
+        {
+            using ComponentType = typename Fetch::component_type;
+            if constexpr (HasSparseComponents && !is_soa_component_v<ComponentType>)
+            {
+                if (sparseComponent != nullptr)
+                {
+                    if constexpr (Fetch::is_optional)
+                    {
+                        return static_cast<ComponentType*>(sparseComponent);
+                    }
+                    else
+                    {
+                        return *static_cast<ComponentType*>(sparseComponent);
+                    }
+                }
+            }
+
+            if constexpr (Fetch::is_optional)
+            {
+                if (column == nullptr || (column->is_enableable() && !chunk.is_enabled(*column, row)))
+                {
+                    return typename Fetch::argument_type{};
+                }
+            }
+
+            if constexpr (is_soa_component_v<ComponentType>)
+            {
+                return soa_ref<ComponentType>(chunk, column, row);
+            }
+            else
+            {
+                // tags have no data, so all of their rows alias the same address
+                ComponentType* component = std::is_empty_v<ComponentType> ? reinterpret_cast<ComponentType*>(columnData)
+                    : reinterpret_cast<ComponentType*>(columnData) + row;
+                if constexpr (Fetch::is_optional)
+                {
+                    return component;
+                }
+                else
+                {
+                    return *component;
+                }
+            }
+        }
+
+        template<typename... Fetches, typename Function, size_t... Indices>
+        static void InvokeForRun(Function& function, const archetype_chunk_t& chunk, const size_t firstRow, 
+            const size_t count, const std::array<const chunk_column_t*, sizeof...(Fetches)>& columns, 
+            std::index_sequence<Indices...>)
+        {
+            function(std::span<const entity_id>(chunk.entities() + firstRow, count), 
+                GetComponentSpan<Fetches>(chunk, firstRow, count, columns[Indices])...);
+        }
+
+        /* Returns the span of count components of the given column, starting from the given row, or an empty 
+           span if there is no column. */
+        template<typename Fetch>
+        static typename Fetch::span_type GetComponentSpan(const archetype_chunk_t& chunk, const size_t firstRow, 
+            const size_t count, const chunk_column_t* column)
+        {
+            using ComponentType = typename Fetch::component_type;
+            if (column == nullptr)
+            {
+                return typename Fetch::span_type();
+            }
+
+            if constexpr (is_soa_component_v<ComponentType>)
+            {
+                return soa_span<ComponentType>(chunk, column, firstRow, count);
+            }
+            else if constexpr (std::is_empty_v<ComponentType>)
+            {
+                // tags have no data: the span only tells how many rows there are
+                return std::span(static_cast<ComponentType*>(chunk.column_data(*column)), count);
+            }
+            else
+            {
+                return std::span(static_cast<ComponentType*>(chunk.column_data(*column)) + firstRow, count);
+            }
+        }
+
+        /* Fetches the components of the entity stored in the given sparse sets, leaving the components without 
+           a sparse set untouched. Returns false if the entity misses any of the non-optional ones. */
+        template<size_t NumComponents>
+        static bool FindSparseComponents(const entity_id entity, 
+            const std::array<const sparse_component_set_t*, NumComponents>& sparseSets,
+            const std::array<bool, NumComponents>& optionalComponents, std::array<void*, NumComponents>& outComponents)
+        {
+            for (size_t i = 0; i < NumComponents; ++i)
+            {
+                if (sparseSets[i] != nullptr && (outComponents[i] = sparseSets[i]->find_component(entity)) == nullptr
+                    && !optionalComponents[i])
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /* Tells whether the entity is in all the required sparse sets and in none of the excluded ones. */
+        static inline bool MatchesSparseSets(const entity_id entity, 
+            std::span<const sparse_component_set_t* const> requiredSparseSets,
+            std::span<const sparse_component_set_t* const> excludedSparseSets)
+        {
+            return std::all_of(requiredSparseSets.begin(), requiredSparseSets.end(), 
+                    [entity](const sparse_component_set_t* sparseSet) { return sparseSet->contains(entity); })
+                && std::none_of(excludedSparseSets.begin(), excludedSparseSets.end(), 
+                    [entity](const sparse_component_set_t* sparseSet) { return sparseSet->contains(entity); });
+        }
+
+        /* Calls the initializer over count consecutive rows of the archetype, starting from firstRow. */
+        template<typename... Components, typename InitializerFunction, size_t... Indices>
+        void InitializeRows(const archetype_set& archetypeSet, const size_t firstRow, const size_t count,
+            InitializerFunction& initializer, std::index_sequence<Indices...>)
+        {
+            const chunk_layout_t& layout = archetypeSet.get_layout();
+            const std::array<component_id, sizeof...(Components)> componentIDs = 
+            { 
+                GetComponentsRegistry()->GetComponentID<Components>()... 
+            };
+
+            std::array<const sparse_component_set_t*, sizeof...(Components)> sparseSets;
+            std::array<const chunk_column_t*, sizeof...(Components)> columns;
+            for (size_t i = 0; i < componentIDs.size(); ++i)
+            {
+                sparseSets[i] = FindSparseSet(componentIDs[i]);
+                columns[i] = sparseSets[i] == nullptr ? &archetypeSet.get_column(componentIDs[i]) : nullptr;
+            }
+
+            const size_t rowsPerChunk = layout.rows_per_chunk();
+            constexpr std::array<bool, sizeof...(Components)> optionalComponents{};
+            std::array<void*, sizeof...(Components)> sparseComponents{};
+            for (size_t index = 0; index < count; ++index)
+            {
+                const size_t row = firstRow + index;
+                const archetype_chunk_t& chunk = archetypeSet.get_chunk(row / rowsPerChunk);
+                FindSparseComponents(chunk.entities()[row % rowsPerChunk], sparseSets, optionalComponents, sparseComponents);
+                initializer(index, GetRowComponent<required_fetch<Components>, true>(chunk, row % rowsPerChunk, columns[Indices], 
+                    columns[Indices] != nullptr ? static_cast<std::byte*>(chunk.column_data(*columns[Indices])) : nullptr,
+                    sparseComponents[Indices])...);
+            }
+        }
+
+        /* Where the data of an entity is stored. */
+        struct entity_location_t
+        {
+            archetype_id archetypeID{INVALID_ARCHETYPE_ID};
+            size_t row{0};
+            entity_id generation{0};
+
+            inline bool is_valid() const { return archetypeID != INVALID_ARCHETYPE_ID; }
+        };
+
+        /* Returns the location of the given entity, or nullptr if the entity is not registered. */
+        inline const entity_location_t* FindEntityLocation(entity_id entity) const
+        {
+            const size_t index = entity_index(entity);
+            if (index < m_entityLocations.size() && m_entityLocations[index].is_valid()
+                && m_entityLocations[index].generation == entity_generation(entity))
+            {
+                return &m_entityLocations[index];
+            }
+
+            return nullptr;
+        }
+
+        const entity_location_t& GetEntityLocation(entity_id entity) const;
+        void SetEntityLocation(entity_id entity, archetype_id archetypeID, size_t row);
 
         void* GetComponent(entity_id entity, const component_id componentID);
         void* FindComponent(entity_id entity, const component_id componentID);
 
+        /* Fetches a pointer to each field of an SoA component of the entity. Throws std::out_of_range if 
+           the entity doesn't have the component. */
+        void GetComponentFields(entity_id entity, const component_id componentID, std::span<void*> outFields);
+
         void AddComponent(entity_id entity, const type_key& componentType);
         void AddComponent(entity_id entity, const component_id componentID);
         void RemoveComponent(entity_id entity, const type_key& componentType);
         void RemoveComponent(entity_id entity, const component_id componentID);
 
-        void MoveEntity(entity_id entity, const archetype& targetArchetype);
+        void MoveEntity(entity_id entity, const archetype_edge_t& edge);
+
+        /* Returns the edge going from the given archetype to the one obtained by adding (or removing) the 
+           given component, creating both the edge and the target archetype if needed. */
+        const archetype_edge_t& GetOrCreateArchetypeEdge(archetype_id sourceArchetypeID, 
+            const component_id componentID, bool isAddition);
 
         archetype_id GetOrCreateArchetypeID(const archetype& archetype);
+
+        /* Frees the storage of an archetype without entities and removes it from all the lookups. 
+           Its ID will be reused by the next new archetype. */
+        void RetireArchetype(const archetype_id archetypeID);
         archetype_set& GetOrCreateArchetypeSet(const archetype& archetype);
 
-        void QueryArchetypes(std::initializer_list<component_id> components, ArchetypesSet& foundArchetypes);
+        void QueryArchetypes(const archetype::Signature& components, ArchetypesSet& foundArchetypes);
+
+        /* Returns the sparse set storing the given component, or nullptr if no entity ever had it. */
+        inline sparse_component_set_t* FindSparseSet(const component_id componentID) const
+        {
+            return componentID < m_sparseSets.size() ? m_sparseSets[componentID].get() : nullptr;
+        }
+
+        /* Returns the sparse set storing the given component, creating it if needed. The component must
+           be stored in sparse sets. */
+        sparse_component_set_t& GetOrCreateSparseSet(const component_id componentID);
+
+        /* Returns the sparse set a query should check for the given component, or nullptr if the component is 
+           stored in archetypes. */
+        const sparse_component_set_t* FindSparseSetForQuery(const component_id componentID);
+
+        /* Removes the entity from all the sparse sets. */
+        void RemoveSparseComponents(entity_id entity);
 
         ComponentsRegistry* GetComponentsRegistry() const; 
         World* GetWorld() const;
 
         /* A map of archetypes to their IDs. */
         pm_unordered_map<archetype, archetype_id, MAX_ENTITIES, MAX_ENTITIES> m_archetypesIDMap;
-        pm_unordered_map<entity_id, archetype_id, MAX_ENTITIES, MAX_ENTITIES> m_entitiesArchetypeHashesMap; 
+
+        /* The location of each entity, indexed by entity index. Unused slots hold an invalid location. */
+        std::vector<entity_location_t> m_entityLocations;
 
         /* Generator for unique archetype IDs.*/
         IDGenerator<archetype_id> m_archetypeIDGenerator;
@@ -186,6 +1295,33 @@ namespace ecs
          */
         pm_unordered_map<component_id, ArchetypesSet, MAX_COMPONENTS, MAX_COMPONENTS> m_componentToArchetypeSetMap;
 
+        /* The sparse sets of the components stored outside of archetypes, indexed by component ID. 
+           Sets are heap-allocated so that they stay in place while queries iterate them. */
+        std::vector<std::unique_ptr<sparse_component_set_t>> m_sparseSets;
+
+        /* The caches of the queries run so far, indexed by query index. Caches are heap-allocated so that 
+           they stay in place while queries walk them. */
+        std::vector<std::unique_ptr<query_cache_t>> m_queryCaches;
+
+        /* The IDs of the retired archetypes, whose slots in m_archetypeSets are free for reuse. */
+        std::vector<archetype_id> m_retiredArchetypeIDs;
+
+        /* The next archetype Compact() will visit. */
+        archetype_id m_compactCursor{0};
+
+        /* How archetypes grow when they run out of rows. */
+        chunk_growth_policy_t m_chunkGrowthPolicy;
+
+        /* Where new archetypes allocate their chunks. */
+        EChunkAllocator m_chunkAllocator{EChunkAllocator::Heap};
+
+        /* The tick changes to components are recorded at. It starts from 1, so that everything is newer than 
+           the last run of a system which never ran. */
+        change_tick_t m_changeTick{1};
+
+        /* The tick queries look for changes after. */
+        change_tick_t m_lastRunTick{0};
+
         /* A reference to the world. */
         std::shared_ptr<World> m_world;
     };
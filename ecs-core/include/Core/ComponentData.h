@@ -1,5 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include "Types.h"
 
 namespace ecs
@@ -8,20 +15,220 @@ namespace ecs
 
     struct IComponent {};
 
+    /**
+     * @brief Type-erased lifecycle operations of a component type.
+     *
+     * Every operation works on a run of count contiguous components. Operations that are trivial for
+     * the component type are left null, and the helpers below replace them with raw memory operations:
+     * this way trivially copyable components are still moved around with a single memcpy per run.
+     */
+    struct component_ops_t
+    {
+        /* Default-constructs the components in uninitialized memory. */
+        void (*construct)(void* data, size_t count){nullptr};
+
+        /* Copy-constructs the source components in uninitialized memory. */
+        void (*copy)(void* destination, const void* source, size_t count){nullptr};
+
+        /* Move-constructs the source components in uninitialized memory, then destroys the sources. */
+        void (*move)(void* destination, void* source, size_t count){nullptr};
+
+        /* Destroys the components, leaving uninitialized memory behind. */
+        void (*destroy)(void* data, size_t count){nullptr};
+
+        template<typename ComponentType>
+        static component_ops_t make()
+        {
+            // chunks default-construct the components of new rows, so there must be a way to do it
+            static_assert(std::is_default_constructible_v<ComponentType>, 
+                "Components must be default constructible");
+
+            component_ops_t ops;
+            if constexpr (!std::is_trivially_default_constructible_v<ComponentType>)
+            {
+                ops.construct = [](void* data, size_t count)
+                {
+                    ComponentType* components = static_cast<ComponentType*>(data);
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        new (components + i) ComponentType();
+                    }
+                };
+            }
+
+            if constexpr (!std::is_trivially_copyable_v<ComponentType>)
+            {
+                ops.copy = [](void* destination, const void* source, size_t count)
+                {
+                    if constexpr (std::is_copy_constructible_v<ComponentType>)
+                    {
+                        ComponentType* destinationComponents = static_cast<ComponentType*>(destination);
+                        const ComponentType* sourceComponents = static_cast<const ComponentType*>(source);
+                        for (size_t i = 0; i < count; ++i)
+                        {
+                            new (destinationComponents + i) ComponentType(sourceComponents[i]);
+                        }
+                    }
+                    else
+                    {
+                        throw std::logic_error("Component type is not copy constructible");
+                    }
+                };
+
+                ops.move = [](void* destination, void* source, size_t count)
+                {
+                    ComponentType* destinationComponents = static_cast<ComponentType*>(destination);
+                    ComponentType* sourceComponents = static_cast<ComponentType*>(source);
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        new (destinationComponents + i) ComponentType(std::move(sourceComponents[i]));
+                        sourceComponents[i].~ComponentType();
+                    }
+                };
+            }
+
+            if constexpr (!std::is_trivially_destructible_v<ComponentType>)
+            {
+                ops.destroy = [](void* data, size_t count)
+                {
+                    ComponentType* components = static_cast<ComponentType*>(data);
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        components[i].~ComponentType();
+                    }
+                };
+            }
+
+            return ops;
+        }
+
+        inline bool is_trivially_copyable() const { return copy == nullptr && move == nullptr; }
+    };
+
+    inline void construct_components(const component_ops_t& ops, void* data, const size_t count)
+    {
+        if (ops.construct != nullptr && count > 0)
+        {
+            ops.construct(data, count);
+        }
+    }
+
+    inline void copy_components(const component_ops_t& ops, const size_t componentSize,
+        void* destination, const void* source, const size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        if (ops.copy != nullptr)
+        {
+            ops.copy(destination, source, count);
+        }
+        else
+        {
+            std::memcpy(destination, source, componentSize * count);
+        }
+    }
+
+    /* Relocates a run of components: the destination must be uninitialized, and the source is left
+       uninitialized. The two runs must not overlap. */
+    inline void move_components(const component_ops_t& ops, const size_t componentSize,
+        void* destination, void* source, const size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        if (ops.move != nullptr)
+        {
+            ops.move(destination, source, count);
+        }
+        else
+        {
+            std::memcpy(destination, source, componentSize * count);
+        }
+    }
+
+    inline void destroy_components(const component_ops_t& ops, void* data, const size_t count)
+    {
+        if (ops.destroy != nullptr && count > 0)
+        {
+            ops.destroy(data, count);
+        }
+    }
+
+    /**
+     * @brief Where the components of a type are stored.
+     */
+    enum class EComponentStorage : unsigned char
+    {
+        /**
+         * @brief In the chunks of the archetypes, as part of their signature. Best for components that are 
+         * iterated often and rarely added or removed.
+         */
+        Archetype,
+
+        /**
+         * @brief In a sparse set, outside of any archetype. Adding and removing these components takes 
+         * constant time and never moves the entity to another archetype, at the cost of slower iteration.
+         */
+        SparseSet
+    };
+
+    /**
+     * @brief Describes a single field of a component stored as a structure of arrays (see SoAComponents.h).
+     */
+    struct component_field_t
+    {
+        /* Offset of the field inside the component. */
+        size_t offset{0};
+        size_t size{0};
+        size_t alignment{1};
+
+        /* Only construct is ever set: fields are trivially copyable and destructible. */
+        component_ops_t ops;
+    };
+
     struct component_data
     {
         component_data() = default;
-        component_data(const size_t& dataSize, const component_id serial, const size_t initialCapacity = 8)
-            : m_dataSize(dataSize), m_serial(serial), m_initialCapacity(initialCapacity)
+        component_data(const size_t& dataSize, const component_id serial, const size_t initialCapacity = 8,
+            const size_t alignment = alignof(std::max_align_t), const component_ops_t& ops = component_ops_t(),
+            const EComponentStorage storage = EComponentStorage::Archetype, const bool enableable = false,
+            std::span<const component_field_t> fields = {})
+            : m_dataSize(dataSize), m_alignment(alignment), m_serial(serial), m_initialCapacity(initialCapacity),
+            m_ops(ops), m_fields(fields), m_storage(storage), m_enableable(enableable)
         {}
 
         inline size_t data_size() const { return m_dataSize; }
+
+        /* Tags are components without any data: they only live in the signature of archetypes. */
+        inline bool is_tag() const { return m_dataSize == 0; }
+        inline size_t alignment() const { return m_alignment; }
         inline size_t initial_capacity() const { return m_initialCapacity; }
         inline component_id serial() const { return m_serial; }
+        inline const component_ops_t& ops() const { return m_ops; }
+        inline EComponentStorage storage() const { return m_storage; }
+        inline bool is_sparse() const { return m_storage == EComponentStorage::SparseSet; }
+
+        /* Enableable components can be switched off for single entities, without removing them. */
+        inline bool is_enableable() const { return m_enableable; }
+
+        /* Components stored as a structure of arrays keep each of their fields in a separate column. 
+           The fields are empty for all the other components. */
+        inline bool is_soa() const { return !m_fields.empty(); }
+        inline std::span<const component_field_t> fields() const { return m_fields; }
 
     private:
         size_t m_dataSize;
+        size_t m_alignment;
         size_t m_initialCapacity;
         component_id m_serial;
+        component_ops_t m_ops;
+        std::span<const component_field_t> m_fields;
+        EComponentStorage m_storage{EComponentStorage::Archetype};
+        bool m_enableable{false};
     };
 }
\ No newline at end of file
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <bit>
+#include <stdexcept>
+#include <initializer_list>
+#include "Types.h"
+#include "ComponentData.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ECS_SIGNATURE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ECS_SIGNATURE_SSE2 1
+#endif
+
+namespace ecs
+{
+    /**
+     * @brief A fixed-size set of component IDs, stored inline as a bitset of MAX_COMPONENTS bits.
+     *
+     * Copying a signature never allocates, its hash is kept up to date on every insertion and removal,
+     * and set-wise tests (superset, intersection) are performed one machine word (or SIMD register)
+     * at a time. Iterating a signature yields the component IDs sorted in ascending order.
+     */
+    struct component_signature
+    {
+    public:
+        static constexpr size_t BitsPerWord = 64;
+        static constexpr size_t NumWords = (MAX_COMPONENTS + BitsPerWord - 1) / BitsPerWord;
+
+        struct iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = component_id;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const component_id*;
+            using reference = component_id;
+
+            iterator() = default;
+            iterator(const component_signature* signature, size_t bit)
+                : m_signature(signature), m_bit(bit)
+            {
+                skip_unset_bits();
+            }
+
+            inline component_id operator*() const { return static_cast<component_id>(m_bit); }
+
+            iterator& operator++()
+            {
+                ++m_bit;
+                skip_unset_bits();
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator previous = *this;
+                ++(*this);
+                return previous;
+            }
+
+            inline bool operator==(const iterator& other) const { return m_bit == other.m_bit; }
+            inline bool operator!=(const iterator& other) const { return m_bit != other.m_bit; }
+
+        private:
+            void skip_unset_bits()
+            {
+                size_t wordIndex = m_bit / BitsPerWord;
+                if (wordIndex >= NumWords)
+                {
+                    m_bit = NumWords * BitsPerWord;
+                    return;
+                }
+
+                uint64_t word = m_signature->m_words[wordIndex] >> (m_bit % BitsPerWord);
+                if (word != 0)
+                {
+                    m_bit += static_cast<size_t>(std::countr_zero(word));
+                    return;
+                }
+
+                for (++wordIndex; wordIndex < NumWords; ++wordIndex)
+                {
+                    if (m_signature->m_words[wordIndex] != 0)
+                    {
+                        m_bit = wordIndex * BitsPerWord + static_cast<size_t>(std::countr_zero(m_signature->m_words[wordIndex]));
+                        return;
+                    }
+                }
+
+                m_bit = NumWords * BitsPerWord;
+            }
+
+            const component_signature* m_signature{nullptr};
+            size_t m_bit{NumWords * BitsPerWord};
+        };
+
+        using const_iterator = iterator;
+
+        component_signature() = default;
+        component_signature(std::initializer_list<component_id> componentIDs)
+        {
+            for (const component_id componentID : componentIDs)
+            {
+                insert(componentID);
+            }
+        }
+
+        inline bool contains(const component_id componentID) const
+        {
+            return componentID < NumWords * BitsPerWord 
+                && (m_words[componentID / BitsPerWord] & bit_mask(componentID)) != 0;
+        }
+
+        inline void insert(const component_id componentID)
+        {
+            check_range(componentID);
+            if (!contains(componentID))
+            {
+                m_words[componentID / BitsPerWord] |= bit_mask(componentID);
+                m_hash ^= hash_component(componentID);
+                m_size += 1;
+            }
+        }
+
+        inline void erase(const component_id componentID)
+        {
+            check_range(componentID);
+            if (contains(componentID))
+            {
+                m_words[componentID / BitsPerWord] &= ~bit_mask(componentID);
+                m_hash ^= hash_component(componentID);
+                m_size -= 1;
+            }
+        }
+
+        inline void clear()
+        {
+            *this = component_signature();
+        }
+
+        inline size_t size() const { return m_size; }
+        inline bool empty() const { return m_size == 0; }
+        inline size_t hash() const { return m_hash; }
+
+        inline iterator begin() const { return iterator(this, 0); }
+        inline iterator end() const { return iterator(this, NumWords * BitsPerWord); }
+
+        /**
+         * @brief Tells whether this signature contains all the components of the other one.
+         */
+        bool contains_all(const component_signature& other) const
+        {
+#if defined(ECS_SIGNATURE_AVX2)
+            for (size_t wordIndex = 0; wordIndex + 4 <= NumWords; wordIndex += 4)
+            {
+                const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m_words + wordIndex));
+                const __m256i otherWords = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other.m_words + wordIndex));
+                if (!_mm256_testc_si256(words, otherWords))
+                {
+                    return false;
+                }
+            }
+#elif defined(ECS_SIGNATURE_SSE2)
+            for (size_t wordIndex = 0; wordIndex + 2 <= NumWords; wordIndex += 2)
+            {
+                const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_words + wordIndex));
+                const __m128i otherWords = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other.m_words + wordIndex));
+                const __m128i common = _mm_and_si128(words, otherWords);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(common, otherWords)) != 0xFFFF)
+                {
+                    return false;
+                }
+            }
+#else
+            for (size_t wordIndex = 0; wordIndex < NumWords; ++wordIndex)
+            {
+                if ((m_words[wordIndex] & other.m_words[wordIndex]) != other.m_words[wordIndex])
+                {
+                    return false;
+                }
+            }
+#endif
+            return true;
+        }
+
+        /**
+         * @brief Tells whether this signature has at least one component in common with the other one.
+         */
+        bool intersects(const component_signature& other) const
+        {
+#if defined(ECS_SIGNATURE_AVX2)
+            for (size_t wordIndex = 0; wordIndex + 4 <= NumWords; wordIndex += 4)
+            {
+                const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m_words + wordIndex));
+                const __m256i otherWords = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other.m_words + wordIndex));
+                if (!_mm256_testz_si256(words, otherWords))
+                {
+                    return true;
+                }
+            }
+#elif defined(ECS_SIGNATURE_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            for (size_t wordIndex = 0; wordIndex + 2 <= NumWords; wordIndex += 2)
+            {
+                const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_words + wordIndex));
+                const __m128i otherWords = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other.m_words + wordIndex));
+                const __m128i common = _mm_and_si128(words, otherWords);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(common, zero)) != 0xFFFF)
+                {
+                    return true;
+                }
+            }
+#else
+            for (size_t wordIndex = 0; wordIndex < NumWords; ++wordIndex)
+            {
+                if ((m_words[wordIndex] & other.m_words[wordIndex]) != 0)
+                {
+                    return true;
+                }
+            }
+#endif
+            return false;
+        }
+
+        bool operator==(const component_signature& other) const
+        {
+            if (m_hash != other.m_hash || m_size != other.m_size)
+            {
+                return false;
+            }
+
+            for (size_t wordIndex = 0; wordIndex < NumWords; ++wordIndex)
+            {
+                if (m_words[wordIndex] != other.m_words[wordIndex])
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        inline bool operator!=(const component_signature& other) const { return !(*this == other); }
+
+    private:
+        static_assert(NumWords % 4 == 0, "The SIMD paths expect MAX_COMPONENTS to be a multiple of 256");
+
+        static inline uint64_t bit_mask(const component_id componentID)
+        {
+            return uint64_t(1) << (componentID % BitsPerWord);
+        }
+
+        static inline void check_range(const component_id componentID)
+        {
+            if (componentID >= NumWords * BitsPerWord)
+            {
+                throw std::out_of_range("Component ID exceeds MAX_COMPONENTS");
+            }
+        }
+
+        /* Mixes the bits of a component ID (splitmix64 finalizer). Hashes of single components are
+           combined with a XOR, which makes the signature hash independent of the insertion order and
+           cheap to update incrementally. */
+        static inline size_t hash_component(const component_id componentID)
+        {
+            uint64_t x = static_cast<uint64_t>(componentID) + 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return static_cast<size_t>(x ^ (x >> 31));
+        }
+
+        uint64_t m_words[NumWords]{};
+        size_t m_size{0};
+        size_t m_hash{0};
+    };
+}
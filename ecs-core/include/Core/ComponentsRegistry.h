@@ -3,10 +3,12 @@
 #include <unordered_map>
 #include <typeinfo>
 #include <typeindex>
+#include <type_traits>
 #include <vector>
 #include "Types.h"
 #include "IDGenerator.h"
 #include "ComponentData.h"
+#include "SoAComponents.h"
 #include "Containers/memory.h"
 #include "Containers/PoolMemoryAllocator.h"
 
@@ -25,7 +27,9 @@ namespace ecs
             auto optionalComponentData = m_componentsClassMap.find(componentName);
             if (optionalComponentData == m_componentsClassMap.end())
             {
-                return AddComponentData(componentName, sizeof(ComponentType), 8);
+                return AddComponentData(componentName, GetDataSize<ComponentType>(), alignof(ComponentType), 
+                    component_ops_t::make<ComponentType>(), 8, EComponentStorage::Archetype, false, 
+                    get_component_fields<ComponentType>());
             }
             else
             {
@@ -59,10 +63,33 @@ namespace ecs
             return componentData;   
         }
 
+        /**
+         * @brief Registers a component type. Components are registered automatically with the default 
+         * settings the first time they are used, so this only needs to be called beforehand to change them.
+         * 
+         * @param initialCapacity The initial capacity of the arrays storing the component.
+         * @param storage Where the components are stored. Components added and removed very often should 
+         * live in sparse sets, so that toggling them does not move the entity to another archetype.
+         * @param enableable Whether the component can be disabled for single entities, which makes queries skip 
+         * them. Only components stored in archetypes can be enableable.
+         * @throw std::logic_error if the component has already been registered with other settings.
+         * @throw std::invalid_argument if an enableable or SoA component is stored in sparse sets.
+         */
         template<typename ComponentType>
-        void RegisterComponent(const size_t initialCapacity = 8)
+        void RegisterComponent(const size_t initialCapacity = 8, 
+            const EComponentStorage storage = EComponentStorage::Archetype, const bool enableable = false)
         {
-            AddComponentData(typeid(ComponentType), sizeof(ComponentType), initialCapacity);
+            AddComponentData(typeid(ComponentType), GetDataSize<ComponentType>(), alignof(ComponentType), 
+                component_ops_t::make<ComponentType>(), initialCapacity, storage, enableable, 
+                get_component_fields<ComponentType>());
+        }
+
+        /* Returns where the components with the given ID are stored. Unknown components are assumed 
+           to be stored in archetypes. */
+        inline EComponentStorage GetComponentStorage(const component_id componentID) const
+        {
+            return componentID < m_componentStorages.size() ? m_componentStorages[componentID] 
+                : EComponentStorage::Archetype;
         }
 
         void Reset()
@@ -70,13 +97,28 @@ namespace ecs
             m_componentIDGenerator.Reset();
             m_componentsClassMap.clear();
             m_componentTypes.clear();
+            m_componentStorages.clear();
         }
 
     private:
-        component_id AddComponentData(const type_key& componentType, const size_t dataSize, const size_t initialCapacity = 8);
+        /* Empty types are registered as tags, with no data at all. */
+        template<typename ComponentType>
+        static constexpr size_t GetDataSize()
+        {
+            return std::is_empty_v<ComponentType> ? 0 : sizeof(ComponentType);
+        }
+
+        component_id AddComponentData(const type_key& componentType, const size_t dataSize, const size_t alignment, 
+            const component_ops_t& ops, const size_t initialCapacity = 8, 
+            const EComponentStorage storage = EComponentStorage::Archetype, const bool enableable = false,
+            std::span<const component_field_t> fields = {});
 
         IDGenerator<component_id> m_componentIDGenerator;
         memory_pool::unordered_map<type_key, component_data> m_componentsClassMap;
         std::vector<type_key> m_componentTypes;
+
+        /* The storage of each component, indexed by component ID, so that it can be checked without 
+           any hash lookup. */
+        std::vector<EComponentStorage> m_componentStorages;
     };
 }
\ No newline at end of file
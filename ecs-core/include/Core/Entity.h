@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <limits>
+#include <span>
 #include "Types.h"
 #include "ComponentData.h"
 #include "ComponentsRegistry.h"
@@ -15,6 +16,7 @@ namespace ecs
     class EntityHandle
     {
         friend class QueryEntityHandle;
+        friend class ArchetypesRegistry;
     public:
         EntityHandle();
         EntityHandle(std::weak_ptr<World> world, entity_id id, archetype_id archetypeID, 
@@ -40,13 +42,23 @@ namespace ecs
             }
         }
 
+        /* Returns a reference to the component, or a soa_ref for SoA components. */
         template<typename ComponentType>
-        ComponentType& GetComponent() const
+        component_reference_t<ComponentType> GetComponent() const
         {
             if (ComponentsRegistry* componentsRegistry = GetComponentsRegistry())
             {
                 const component_id componentID = componentsRegistry->GetComponentID<ComponentType>();
-                return *static_cast<ComponentType*>(GetComponent(componentID));
+                if constexpr (is_soa_component_v<ComponentType>)
+                {
+                    typename soa_ref<ComponentType>::fields_array fields;
+                    GetComponentFields(componentID, fields);
+                    return soa_ref<ComponentType>(fields);
+                }
+                else
+                {
+                    return *static_cast<ComponentType*>(GetComponent(componentID));
+                }
             }
 
             throw std::runtime_error("Components registry not found");
@@ -55,6 +67,7 @@ namespace ecs
         template<typename ComponentType>
         ComponentType* FindComponent() const
         {
+            static_assert(!is_soa_component_v<ComponentType>, "SoA components can only be accessed through GetComponent()");
             if (ComponentsRegistry* componentsRegistry = GetComponentsRegistry())
             {
                 const component_id componentID = componentsRegistry->GetComponentID<ComponentType>();
@@ -83,25 +96,70 @@ namespace ecs
             }
         }
 
+        /**
+         * @brief Enables or disables a component of the entity. Queries skip the entity while any of the
+         * components they look for is disabled. The component must have been registered as enableable.
+         */
+        template<typename ComponentType>
+        void SetComponentEnabled(const bool enabled)
+        {
+            if (ComponentsRegistry* componentsRegistry = GetComponentsRegistry())
+            {
+                SetComponentEnabled(componentsRegistry->GetComponentID<ComponentType>(), enabled);
+            }
+        }
+
+        template<typename ComponentType>
+        bool IsComponentEnabled() const
+        {
+            if (ComponentsRegistry* componentsRegistry = GetComponentsRegistry())
+            {
+                return IsComponentEnabled(componentsRegistry->GetComponentID<ComponentType>());
+            }
+
+            throw std::runtime_error("Components registry not found");
+        }
+
+        /**
+         * @brief Tells whether the handle still refers to an alive entity. Handles become stale when
+         * their entity is destroyed, even if its ID gets recycled by a new entity.
+         */
+        bool IsValid() const;
+
         inline entity_id id() const { return m_id; }
         inline archetype_id archetypeID() const { return m_archetypeID; }
-        inline std::weak_ptr<World> world() const { return m_world;}
+        std::weak_ptr<World> world() const;
 
         ArchetypesRegistry* GetArchetypesRegistry() const;
         ComponentsRegistry* GetComponentsRegistry() const;
-        World* GetWorld() const { return m_world.lock().get();}
+        World* GetWorld() const;
 
     private:
+        /**
+         * @brief Builds the handle passed to the function of a query, which borrows the world and the buffer of 
+         * deferred changes for the duration of the pass. Copying it touches no reference count, so that 
+         * threads visiting entities at the same time don't contend for the same counters.
+         */
+        EntityHandle(World* world, entity_id id, archetype_id archetypeID, 
+            BatchComponentActionProcessor* batchComponentActionProcessor);
+
         void AddComponent(component_id componentID);
         void DeferredAddComponent(component_id componentID);
         void* GetComponent(component_id componentID) const;
         void* FindComponent(component_id componentID) const noexcept;
+        void GetComponentFields(component_id componentID, std::span<void*> outFields) const;
         void RemoveComponent(component_id componentID);
         void DeferredRemoveComponent(component_id componentID);
+        void SetComponentEnabled(component_id componentID, const bool enabled);
+        bool IsComponentEnabled(component_id componentID) const;
 
         entity_id m_id;
         archetype_id m_archetypeID;
         std::weak_ptr<World> m_world;
-        std::shared_ptr<BatchComponentActionProcessor> m_batchComponentActionProcessor;
+        World* m_borrowedWorld{nullptr};
+        BatchComponentActionProcessor* m_batchComponentActionProcessor{nullptr};
+
+        /* Keeps the buffer of deferred changes alive, unless the handle borrows it. */
+        std::shared_ptr<BatchComponentActionProcessor> m_batchComponentActionProcessorOwner;
     };
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #pragma once 
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
 #include <stdexcept>
+#include <vector>
+#include <cstdint>
+#include <span>
 
 namespace ecs
 {
@@ -37,4 +42,132 @@ namespace ecs
         IDType m_nextID = 0;
         IDType m_maxID = 0;
     };
+
+    /*  This class assigns a dense index to each type it is asked about, the first time it is asked.
+        Indices are unique within the same Family, and looking them up afterwards costs nothing but a 
+        static variable read, which makes them suitable for indexing plain vectors by type. */
+    template<typename Family>
+    class TypeIndexGenerator
+    {
+    public:
+        template<typename Type>
+        static size_t GetTypeIndex()
+        {
+            static const size_t s_typeIndex = s_nextTypeIndex.fetch_add(1);
+            return s_typeIndex;
+        }
+
+    private:
+        static inline std::atomic<size_t> s_nextTypeIndex{0};
+    };
+
+    /*  This class generates IDs made of a slot index (the low IndexBits bits) and a generation
+        (the remaining high bits). Released IDs give their slot back to a free list, so that the
+        next generated ID reuses it with an incremented generation: indices stay as compact as
+        the number of alive IDs, while stale IDs can be detected by comparing generations. */
+    template<typename IDType, size_t IndexBits>
+    class GenerationalIDGenerator
+    {
+    public:
+        static_assert(IndexBits > 0 && IndexBits < sizeof(IDType) * 8,
+            "IndexBits must leave room for the generation");
+
+        using generation_t = IDType;
+
+        static constexpr IDType IndexMask = (IDType(1) << IndexBits) - 1;
+        static constexpr generation_t MaxGeneration = std::numeric_limits<IDType>::max() >> IndexBits;
+
+        static constexpr size_t GetIndex(const IDType id) { return static_cast<size_t>(id & IndexMask); }
+        static constexpr generation_t GetGeneration(const IDType id) { return id >> IndexBits; }
+        static constexpr IDType MakeID(const size_t index, const generation_t generation)
+        {
+            return (generation << IndexBits) | (static_cast<IDType>(index) & IndexMask);
+        }
+
+        IDType GenerateNewUniqueID()
+        {
+            if (!m_freeIndices.empty())
+            {
+                const size_t index = m_freeIndices.back();
+                m_freeIndices.pop_back();
+                return MakeID(index, m_generations[index]);
+            }
+
+            // the last index is reserved, so that the maximum value of IDType is never generated
+            if (m_generations.size() == IndexMask)
+            {
+                throw std::overflow_error("Reached maximum counter of unique ID");
+            }
+
+            m_generations.push_back(0);
+            return MakeID(m_generations.size() - 1, 0);
+        }
+
+        /*  Fills the given span with new unique IDs, reusing released slots first and then
+            appending all the new slots at once. */
+        void GenerateNewUniqueIDs(std::span<IDType> outIDs)
+        {
+            const size_t numRecycledIDs = std::min(outIDs.size(), m_freeIndices.size());
+            const size_t numNewSlots = outIDs.size() - numRecycledIDs;
+            if (numNewSlots > IndexMask - m_generations.size())
+            {
+                throw std::overflow_error("Reached maximum counter of unique ID");
+            }
+
+            size_t numGeneratedIDs = 0;
+            while (numGeneratedIDs < numRecycledIDs)
+            {
+                outIDs[numGeneratedIDs++] = GenerateNewUniqueID();
+            }
+
+            const size_t firstNewIndex = m_generations.size();
+            m_generations.resize(firstNewIndex + numNewSlots, 0);
+            for (size_t i = 0; i < numNewSlots; ++i)
+            {
+                outIDs[numGeneratedIDs + i] = MakeID(firstNewIndex + i, 0);
+            }
+        }
+
+        /*  Gives the slot of the ID back to the generator. Returns false if the ID was already
+            released or never generated. */
+        bool ReleaseID(const IDType id)
+        {
+            if (!IsAlive(id))
+            {
+                return false;
+            }
+
+            const size_t index = GetIndex(id);
+            m_generations[index] += 1;
+
+            // slots whose generation is exhausted are retired instead of wrapping around
+            if (m_generations[index] != MaxGeneration)
+            {
+                m_freeIndices.push_back(index);
+            }
+
+            return true;
+        }
+
+        inline bool IsAlive(const IDType id) const
+        {
+            const size_t index = GetIndex(id);
+            return index < m_generations.size() && m_generations[index] == GetGeneration(id);
+        }
+
+        /*  Returns the amount of slots ever handed out, which is an upper bound of the index of
+            any alive ID. */
+        inline size_t GetNumSlots() const { return m_generations.size(); }
+        inline size_t GetNumAliveIDs() const { return m_generations.size() - m_freeIndices.size(); }
+
+        void Reset()
+        {
+            m_generations.clear();
+            m_freeIndices.clear();
+        }
+
+    private:
+        std::vector<generation_t> m_generations;
+        std::vector<size_t> m_freeIndices;
+    };
 }
@@ -9,7 +9,14 @@ namespace ecs
 
     class ISystem
     {
+        friend class World;
     public:
         virtual void Update(std::weak_ptr<World> world, real_t deltaTime) {}
+
+        /* Returns the change tick the system last ran at, or 0 if it never ran. */
+        inline change_tick_t GetLastRunTick() const { return m_lastRunTick; }
+
+    private:
+        change_tick_t m_lastRunTick{0};
     };
 }
\ No newline at end of file
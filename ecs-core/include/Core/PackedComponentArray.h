@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <memory>
+#include <new>
+#include <cstring>
 #include "ComponentData.h"
 #include "ComponentsRegistry.h"
 
@@ -22,27 +24,37 @@ namespace ecs
             std::swap(m_size, other.m_size);
             std::swap(m_serial, other.m_serial);
             std::swap(m_instanceSize, other.m_instanceSize);
+            std::swap(m_alignment, other.m_alignment);
+            std::swap(m_ops, other.m_ops);
             std::swap(m_capacity, other.m_capacity);
             return *this;
         }
 
         packed_component_array_t& operator=(const packed_component_array_t& other)
         {
-            m_serial = other.component_serial();
-            m_size = other.size();
-            m_instanceSize = other.component_size();
-            m_capacity = other.capacity();
-            std::memcpy(other.m_data.get(), m_data.get(), m_instanceSize * m_capacity);
+            if (this != &other)
+            {
+                packed_component_array_t copy(other);
+                *this = std::move(copy);
+            }
             return *this;
         }
 
         inline size_t size() const { return m_size; }
         inline component_id component_serial() const { return m_serial; }
         inline size_t component_size() const { return m_instanceSize; }
+        inline size_t alignment() const { return m_alignment; }
         inline size_t capacity() const { return m_capacity; }
 
         /**
-         * @brief Adds a component at the end of the array. 
+         * @brief Returns a pointer to the first component of the array. 
+         * 
+         * The pointer is aligned to the alignment of the component type.
+         */
+        inline void* data() const { return m_data.get(); }
+
+        /**
+         * @brief Adds a default-constructed component at the end of the array. 
          * 
          * @return Pointer to the added component.
          */
@@ -64,7 +76,7 @@ namespace ecs
         void* last() const { return get_component(m_size - 1); }
 
         /**
-         * @brief Deletes the component at the given index. 
+         * @brief Destroys the component at the given index, moving the last component in its place. 
          * 
          * @param index The index of the component to delete.
          */
@@ -79,11 +91,43 @@ namespace ecs
          */
         void copy_to(size_t index, packed_component_array_t& destination, size_t destinationIndex);
 
+        /**
+         * @brief Reallocates the array so that its capacity matches its size, releasing the unused memory. 
+         * 
+         * @return true if any memory has been released.
+         */
+        bool shrink_to_fit();
+
+    protected:
+        /**
+         * @brief Adds a slot at the end of the array, without constructing any component in it. 
+         * 
+         * @return Pointer to the uninitialized slot.
+         */
+        void* add_uninitialized_component();
+
     private:
-        std::unique_ptr<void, void(*)(void*)> m_data;
+        struct aligned_deleter
+        {
+            size_t alignment{alignof(std::max_align_t)};
+
+            void operator()(void* data) const 
+            { 
+                ::operator delete[](data, std::align_val_t(alignment)); 
+            }
+        };
+
+        using aligned_data_ptr = std::unique_ptr<void, aligned_deleter>;
+
+        /* Allocates room for the given amount of components, aligned to the component alignment. */
+        aligned_data_ptr allocate(const size_t capacity) const;
+
+        aligned_data_ptr m_data;
         size_t m_size;
         component_id m_serial;
         size_t m_instanceSize;
+        size_t m_alignment;
+        component_ops_t m_ops;
         size_t m_capacity;
     };
 
@@ -113,7 +157,7 @@ namespace ecs
         template<typename... Args>
         ComponentType& emplace_component(Args&&... args)
         {
-            ComponentType* component = static_cast<ComponentType*>(packed_component_array_t::add_component());
+            void* component = packed_component_array_t::add_uninitialized_component();
             return *new (component) ComponentType(std::forward<Args>(args)...);
         }
 
@@ -1,14 +1,178 @@
 #pragma once 
 
+#include <functional>
 #include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
 #include "Types.h"
 #include "Entity.h"
 #include "ComponentsRegistry.h"
+#include "SoAComponents.h"
 
 namespace ecs 
 {
     class World;
 
+    /**
+     * @brief Query term matching the entities having all the given components, without fetching them.
+     */
+    template<typename... Components>
+    struct With {};
+
+    /**
+     * @brief Query term matching the entities having none of the given components. Exclusions are resolved 
+     * when matching archetypes: disabling a component doesn't make its entity match.
+     */
+    template<typename... Components>
+    struct Without {};
+
+    /**
+     * @brief Query term fetching the given components when the entity has them, as nullable pointers 
+     * (std::optional of soa_ref for SoA components). Disabled components are fetched as null.
+     */
+    template<typename... Components>
+    struct Optional {};
+
+    /**
+     * @brief Query term matching the entities whose given components have been written since the last run of 
+     * the system running the query, without fetching them. Changes are tracked per chunk, so entities sharing 
+     * a chunk with a changed component match as well. Components are written by fetching them as non-const 
+     * in queries, or by getting them from their entity.
+     */
+    template<typename... Components>
+    struct Changed {};
+
+    /**
+     * @brief Query term matching the entities which got the given components since the last run of the system 
+     * running the query, without fetching them. Like Changed, additions are tracked per chunk.
+     */
+    template<typename... Components>
+    struct Added {};
+
+    template<typename... Types>
+    struct type_list {};
+
+    template<typename... Lists>
+    struct type_list_concat
+    {
+        using type = type_list<>;
+    };
+
+    template<typename... Types>
+    struct type_list_concat<type_list<Types...>>
+    {
+        using type = type_list<Types...>;
+    };
+
+    template<typename... Types, typename... OtherTypes, typename... Lists>
+    struct type_list_concat<type_list<Types...>, type_list<OtherTypes...>, Lists...>
+    {
+        using type = typename type_list_concat<type_list<Types..., OtherTypes...>, Lists...>::type;
+    };
+
+    /* A component a query hands out to its callback, which entities must have. Components fetched as const 
+       are only read, so they don't mark their chunks as changed. SoA components are always fetched as soa_ref. */
+    template<typename ComponentType>
+    struct required_fetch
+    {
+        using component_type = std::remove_const_t<ComponentType>;
+        using argument_type = std::conditional_t<is_soa_component_v<component_type>, soa_ref<component_type>, 
+            ComponentType&>;
+        using span_type = std::conditional_t<is_soa_component_v<component_type>, soa_span<component_type>, 
+            std::span<ComponentType>>;
+        static constexpr bool is_optional = false;
+        static constexpr bool is_read_only = std::is_const_v<ComponentType>;
+    };
+
+    /* A component a query hands out to its callback when the entity has it. */
+    template<typename ComponentType>
+    struct optional_fetch
+    {
+        using component_type = std::remove_const_t<ComponentType>;
+        using argument_type = std::conditional_t<is_soa_component_v<component_type>, 
+            std::optional<soa_ref<component_type>>, ComponentType*>;
+        using span_type = typename required_fetch<ComponentType>::span_type;
+        static constexpr bool is_optional = true;
+        static constexpr bool is_read_only = std::is_const_v<ComponentType>;
+    };
+
+    /* A component whose change ticks a query compares with the last run of its system. */
+    template<typename ComponentType, bool IsAddition>
+    struct change_filter
+    {
+        static_assert(!std::is_empty_v<ComponentType>, "Tags have no data, so their changes are not tracked");
+        using component_type = ComponentType;
+        static constexpr bool is_addition = IsAddition;
+    };
+
+    /* What a single argument of a query contributes to it. Plain components are required and fetched. */
+    struct query_term_base
+    {
+        using fetches = type_list<>;
+        using with = type_list<>;
+        using without = type_list<>;
+        using change_filters = type_list<>;
+    };
+
+    template<typename Term>
+    struct query_term : public query_term_base
+    {
+        using fetches = type_list<required_fetch<Term>>;
+    };
+
+    template<typename... Components>
+    struct query_term<With<Components...>> : public query_term_base
+    {
+        using with = type_list<Components...>;
+    };
+
+    template<typename... Components>
+    struct query_term<Without<Components...>> : public query_term_base
+    {
+        using without = type_list<Components...>;
+    };
+
+    template<typename... Components>
+    struct query_term<Optional<Components...>> : public query_term_base
+    {
+        using fetches = type_list<optional_fetch<Components>...>;
+    };
+
+    template<typename... Components>
+    struct query_term<Changed<Components...>> : public query_term_base
+    {
+        using change_filters = type_list<change_filter<Components, false>...>;
+    };
+
+    template<typename... Components>
+    struct query_term<Added<Components...>> : public query_term_base
+    {
+        using change_filters = type_list<change_filter<Components, true>...>;
+    };
+
+    /**
+     * @brief Splits the arguments of a query into the components it fetches, in order, and the components 
+     * it only filters by.
+     */
+    template<typename... Terms>
+    struct query_terms
+    {
+        using fetches = typename type_list_concat<typename query_term<Terms>::fetches...>::type;
+        using with = typename type_list_concat<typename query_term<Terms>::with...>::type;
+        using without = typename type_list_concat<typename query_term<Terms>::without...>::type;
+        using change_filters = typename type_list_concat<typename query_term<Terms>::change_filters...>::type;
+    };
+
+    template<typename Fetches>
+    struct query_iteration_function;
+
+    template<typename... Fetches>
+    struct query_iteration_function<type_list<Fetches...>>
+    {
+        using type = std::function<void(EntityHandle, typename Fetches::argument_type...)>;
+    };
+
     struct query_base 
     {
     public:
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "ComponentData.h"
+#include "ArchetypeChunk.h"
+
+namespace ecs
+{
+    /**
+     * @brief Opts a component into the structure of arrays layout when specialized with a tuple of pointers
+     * to all of its data members, named members. Prefer the ECS_SOA_COMPONENT macro to specializing it by hand.
+     *
+     * Each field of such a component gets its own column in the chunks of the archetypes, so that loops
+     * over a single field are unit-stride. Since the component never exists as a whole in memory, it is
+     * accessed through soa_ref instead of a reference.
+     */
+    template<typename ComponentType>
+    struct soa_fields {};
+
+    template<typename ComponentType>
+    inline constexpr bool is_soa_component_v = requires { soa_fields<ComponentType>::members; };
+
+    template<typename ComponentType>
+    inline constexpr size_t soa_num_fields_v =
+        std::tuple_size_v<std::remove_cv_t<decltype(soa_fields<ComponentType>::members)>>;
+
+    template<typename MemberPointer>
+    struct soa_member_traits;
+
+    template<typename ComponentType, typename FieldType>
+    struct soa_member_traits<FieldType ComponentType::*>
+    {
+        using field_type = FieldType;
+    };
+
+    /* The type of the field at the given index of an SoA component. */
+    template<typename ComponentType, size_t FieldIndex>
+    using soa_field_t = typename soa_member_traits<std::remove_cv_t<std::tuple_element_t<FieldIndex,
+        std::remove_cv_t<decltype(soa_fields<ComponentType>::members)>>>>::field_type;
+
+    /* Returns the index of the field of an SoA component the given member pointer refers to. */
+    template<typename ComponentType, auto Member, size_t FieldIndex = 0>
+    constexpr size_t soa_field_index()
+    {
+        if constexpr (FieldIndex == soa_num_fields_v<ComponentType>)
+        {
+            static_assert(FieldIndex < soa_num_fields_v<ComponentType>, "Member is not a field of the SoA component");
+            return FieldIndex;
+        }
+        else
+        {
+            constexpr auto fieldMember = std::get<FieldIndex>(soa_fields<ComponentType>::members);
+            if constexpr (std::is_same_v<std::remove_cv_t<decltype(fieldMember)>, decltype(Member)>)
+            {
+                if constexpr (fieldMember == Member)
+                {
+                    return FieldIndex;
+                }
+                else
+                {
+                    return soa_field_index<ComponentType, Member, FieldIndex + 1>();
+                }
+            }
+            else
+            {
+                return soa_field_index<ComponentType, Member, FieldIndex + 1>();
+            }
+        }
+    }
+
+    /* Returns the size of a struct deriving from IComponent whose members are the fields of an SoA component. */
+    template<typename ComponentType, size_t... FieldIndices>
+    constexpr size_t soa_fields_struct_size(std::index_sequence<FieldIndices...>)
+    {
+        constexpr std::array<size_t, sizeof...(FieldIndices)> sizes =
+            { sizeof(soa_field_t<ComponentType, FieldIndices>)... };
+        constexpr std::array<size_t, sizeof...(FieldIndices)> alignments =
+            { alignof(soa_field_t<ComponentType, FieldIndices>)... };
+
+        size_t size = 0;
+        size_t structAlignment = alignof(IComponent);
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            size = (size + alignments[i] - 1) / alignments[i] * alignments[i] + sizes[i];
+            structAlignment = alignments[i] > structAlignment ? alignments[i] : structAlignment;
+        }
+        return (size + structAlignment - 1) / structAlignment * structAlignment;
+    }
+
+    template<typename FirstMember, typename SecondMember>
+    constexpr bool soa_same_member(const FirstMember firstMember, const SecondMember secondMember)
+    {
+        if constexpr (std::is_same_v<FirstMember, SecondMember>)
+        {
+            return firstMember == secondMember;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    /* Tells whether no field of an SoA component but the one at the given index refers to its member. */
+    template<typename ComponentType, size_t FieldIndex, size_t... OtherIndices>
+    constexpr bool soa_field_unique(std::index_sequence<OtherIndices...>)
+    {
+        constexpr auto member = std::get<FieldIndex>(soa_fields<ComponentType>::members);
+        return ((OtherIndices == FieldIndex 
+            || !soa_same_member(member, std::get<OtherIndices>(soa_fields<ComponentType>::members))) && ...);
+    }
+
+    template<typename ComponentType, size_t... FieldIndices>
+    constexpr bool soa_fields_unique(std::index_sequence<FieldIndices...> fieldIndices)
+    {
+        return (soa_field_unique<ComponentType, FieldIndices>(fieldIndices) && ...);
+    }
+
+    /**
+     * @brief Whether the declared fields of an SoA component are its data members, each listed once: no field 
+     * refers to the same member as another one, and together they account for all the bytes of the component. 
+     * A member left out would have no column, so its value would be lost.
+     */
+    template<typename ComponentType>
+    inline constexpr bool soa_fields_complete_v = 
+        soa_fields_unique<ComponentType>(std::make_index_sequence<soa_num_fields_v<ComponentType>>())
+        && sizeof(ComponentType) == 
+            soa_fields_struct_size<ComponentType>(std::make_index_sequence<soa_num_fields_v<ComponentType>>());
+
+    /**
+     * @brief Proxy to a component stored as a structure of arrays: holds a pointer to each of its fields.
+     *
+     * Proxies are cheap to copy, and stay valid as long as the entity doesn't change archetype.
+     */
+    template<typename ComponentType>
+    struct soa_ref
+    {
+    public:
+        static constexpr size_t NUM_FIELDS = soa_num_fields_v<ComponentType>;
+        using fields_array = std::array<void*, NUM_FIELDS>;
+
+        explicit soa_ref(const fields_array& fields) : m_fields(fields) {}
+
+        /**
+         * @brief Builds the proxy of the component in the given row of a chunk.
+         *
+         * @param fieldColumns The columns of the fields of the component, which are always consecutive.
+         */
+        soa_ref(const archetype_chunk_t& chunk, const chunk_column_t* fieldColumns, const size_t row)
+        {
+            for (size_t fieldIndex = 0; fieldIndex < NUM_FIELDS; ++fieldIndex)
+            {
+                m_fields[fieldIndex] = chunk.get_component(fieldColumns[fieldIndex], row);
+            }
+        }
+
+        /**
+         * @brief Returns the field the given member pointer refers to, e.g. get<&Velocity::x>().
+         */
+        template<auto Member>
+        inline auto& get() const
+        {
+            return field<soa_field_index<ComponentType, Member>()>();
+        }
+
+        /**
+         * @brief Returns the field at the given index, in the order the fields have been declared.
+         */
+        template<size_t FieldIndex>
+        inline soa_field_t<ComponentType, FieldIndex>& field() const
+        {
+            return *static_cast<soa_field_t<ComponentType, FieldIndex>*>(m_fields[FieldIndex]);
+        }
+
+        /**
+         * @brief Gathers all the fields into a copy of the component.
+         */
+        ComponentType load() const
+        {
+            ComponentType component;
+            load_fields(component, std::make_index_sequence<NUM_FIELDS>());
+            return component;
+        }
+
+        /**
+         * @brief Scatters all the fields of the given component.
+         */
+        void store(const ComponentType& component) const
+        {
+            store_fields(component, std::make_index_sequence<NUM_FIELDS>());
+        }
+
+    private:
+        template<size_t... FieldIndices>
+        void load_fields(ComponentType& component, std::index_sequence<FieldIndices...>) const
+        {
+            ((component.*std::get<FieldIndices>(soa_fields<ComponentType>::members) = field<FieldIndices>()), ...);
+        }
+
+        template<size_t... FieldIndices>
+        void store_fields(const ComponentType& component, std::index_sequence<FieldIndices...>) const
+        {
+            ((field<FieldIndices>() = component.*std::get<FieldIndices>(soa_fields<ComponentType>::members)), ...);
+        }
+
+        fields_array m_fields;
+    };
+
+    /**
+     * @brief A run of consecutive components stored as a structure of arrays: holds a span for each field,
+     * so that loops over a field are unit-stride and can be vectorized.
+     */
+    template<typename ComponentType>
+    struct soa_span
+    {
+    public:
+        static constexpr size_t NUM_FIELDS = soa_num_fields_v<ComponentType>;
+        using fields_array = typename soa_ref<ComponentType>::fields_array;
+
+        soa_span() = default;
+        soa_span(const fields_array& fields, const size_t size) : m_fields(fields), m_size(size) {}
+
+        /**
+         * @brief Builds the span of count components of a chunk, starting from the given row.
+         *
+         * @param fieldColumns The columns of the fields of the component, which are always consecutive.
+         */
+        soa_span(const archetype_chunk_t& chunk, const chunk_column_t* fieldColumns, const size_t firstRow, 
+            const size_t count)
+            : m_size(count)
+        {
+            for (size_t fieldIndex = 0; fieldIndex < NUM_FIELDS; ++fieldIndex)
+            {
+                m_fields[fieldIndex] = chunk.get_component(fieldColumns[fieldIndex], firstRow);
+            }
+        }
+
+        inline size_t size() const { return m_size; }
+        inline bool empty() const { return m_size == 0; }
+
+        /**
+         * @brief Returns the values of the field the given member pointer refers to, e.g. get<&Velocity::x>().
+         */
+        template<auto Member>
+        inline auto get() const
+        {
+            return field<soa_field_index<ComponentType, Member>()>();
+        }
+
+        /**
+         * @brief Returns the values of the field at the given index, in the order the fields have been declared.
+         */
+        template<size_t FieldIndex>
+        inline std::span<soa_field_t<ComponentType, FieldIndex>> field() const
+        {
+            return std::span(static_cast<soa_field_t<ComponentType, FieldIndex>*>(m_fields[FieldIndex]), m_size);
+        }
+
+        /**
+         * @brief Returns the proxy of the component at the given index.
+         */
+        soa_ref<ComponentType> operator[](const size_t index) const
+        {
+            return at(index, std::make_index_sequence<NUM_FIELDS>());
+        }
+
+    private:
+        template<size_t... FieldIndices>
+        soa_ref<ComponentType> at(const size_t index, std::index_sequence<FieldIndices...>) const
+        {
+            return soa_ref<ComponentType>(fields_array{ static_cast<void*>(field<FieldIndices>().data() + index)... });
+        }
+
+        fields_array m_fields{};
+        size_t m_size{0};
+    };
+
+    /* What component accessors hand out: a reference, or a proxy for SoA components. */
+    template<typename ComponentType>
+    using component_reference_t = std::conditional_t<is_soa_component_v<ComponentType>, soa_ref<ComponentType>,
+        ComponentType&>;
+
+    /* What optional component accessors hand out: a nullable pointer, or an optional proxy for SoA components. */
+    template<typename ComponentType>
+    using component_pointer_t = std::conditional_t<is_soa_component_v<ComponentType>, 
+        std::optional<soa_ref<ComponentType>>, ComponentType*>;
+
+    /* What chunk iteration hands out for a run of components: a span, or a soa_span for SoA components. */
+    template<typename ComponentType>
+    using component_span_t = std::conditional_t<is_soa_component_v<ComponentType>, soa_span<ComponentType>,
+        std::span<ComponentType>>;
+
+    /* Default-constructs count copies of a field, taking its value from a default-constructed component. */
+    template<typename ComponentType, size_t FieldIndex>
+    void construct_soa_field(void* data, size_t count)
+    {
+        const ComponentType defaultComponent{};
+        std::uninitialized_fill_n(static_cast<soa_field_t<ComponentType, FieldIndex>*>(data), count,
+            defaultComponent.*std::get<FieldIndex>(soa_fields<ComponentType>::members));
+    }
+
+    template<typename ComponentType, size_t... FieldIndices>
+    std::array<component_field_t, sizeof...(FieldIndices)> make_soa_fields(std::index_sequence<FieldIndices...>)
+    {
+        static_assert(std::is_trivially_copyable_v<ComponentType>,
+            "SoA components must be trivially copyable: their fields are moved around one by one");
+        static_assert(std::is_default_constructible_v<ComponentType>, "SoA components must be default constructible");
+
+        const ComponentType component{};
+        const auto makeField = [&component]<size_t FieldIndex>()
+        {
+            using field_type = soa_field_t<ComponentType, FieldIndex>;
+            component_field_t field;
+            field.offset = static_cast<size_t>(reinterpret_cast<const std::byte*>(
+                &(component.*std::get<FieldIndex>(soa_fields<ComponentType>::members)))
+                - reinterpret_cast<const std::byte*>(&component));
+            field.size = sizeof(field_type);
+            field.alignment = alignof(field_type);
+            if constexpr (!std::is_trivially_default_constructible_v<ComponentType>)
+            {
+                field.ops.construct = &construct_soa_field<ComponentType, FieldIndex>;
+            }
+
+            return field;
+        };
+
+        return { makeField.template operator()<FieldIndices>()... };
+    }
+
+    /**
+     * @brief Returns the descriptions of the fields of a component, which are empty unless the component
+     *        is stored as a structure of arrays.
+     */
+    template<typename ComponentType>
+    std::span<const component_field_t> get_component_fields()
+    {
+        if constexpr (is_soa_component_v<ComponentType>)
+        {
+            static const std::array<component_field_t, soa_num_fields_v<ComponentType>> fields =
+                make_soa_fields<ComponentType>(std::make_index_sequence<soa_num_fields_v<ComponentType>>());
+            return fields;
+        }
+        else
+        {
+            return {};
+        }
+    }
+}
+
+#define ECS_SOA_MEMBER_1(Type, Field) &Type::Field
+#define ECS_SOA_MEMBER_2(Type, Field, ...) &Type::Field, ECS_SOA_MEMBER_1(Type, __VA_ARGS__)
+#define ECS_SOA_MEMBER_3(Type, Field, ...) &Type::Field, ECS_SOA_MEMBER_2(Type, __VA_ARGS__)
+#define ECS_SOA_MEMBER_4(Type, Field, ...) &Type::Field, ECS_SOA_MEMBER_3(Type, __VA_ARGS__)
+#define ECS_SOA_MEMBER_5(Type, Field, ...) &Type::Field, ECS_SOA_MEMBER_4(Type, __VA_ARGS__)
+#define ECS_SOA_MEMBER_6(Type, Field, ...) &Type::Field, ECS_SOA_MEMBER_5(Type, __VA_ARGS__)
+#define ECS_SOA_MEMBER_7(Type, Field, ...) &Type::Field, ECS_SOA_MEMBER_6(Type, __VA_ARGS__)
+#define ECS_SOA_MEMBER_8(Type, Field, ...) &Type::Field, ECS_SOA_MEMBER_7(Type, __VA_ARGS__)
+#define ECS_SOA_SELECT_MEMBERS(_1, _2, _3, _4, _5, _6, _7, _8, Name, ...) Name
+
+/**
+ * Stores the given component as a structure of arrays, declaring its fields (up to 8). Every data member
+ * of the component must be listed once, in declaration order: members left out would not be stored, so a
+ * compile-time check rejects field lists with duplicates, or that do not add up to the size of the
+ * component when laid out in that order. Must be used in the global namespace, e.g.:
+ *
+ * ECS_SOA_COMPONENT(comps::Velocity, x, y)
+ */
+#define ECS_SOA_COMPONENT(Type, ...) \
+    template<> \
+    struct ecs::soa_fields<Type> \
+    { \
+        static constexpr auto members = std::make_tuple(ECS_SOA_SELECT_MEMBERS(__VA_ARGS__, ECS_SOA_MEMBER_8, \
+            ECS_SOA_MEMBER_7, ECS_SOA_MEMBER_6, ECS_SOA_MEMBER_5, ECS_SOA_MEMBER_4, ECS_SOA_MEMBER_3, \
+            ECS_SOA_MEMBER_2, ECS_SOA_MEMBER_1)(Type, __VA_ARGS__)); \
+    }; \
+    static_assert(ecs::soa_fields_complete_v<Type>, \
+        "ECS_SOA_COMPONENT must list every data member of " #Type " once, in declaration order");
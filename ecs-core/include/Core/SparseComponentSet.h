@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include "Types.h"
+#include "ComponentData.h"
+#include "PackedComponentArray.h"
+
+namespace ecs
+{
+    /**
+     * @brief Stores the components of a single type outside of archetypes.
+     *
+     * Components are packed in a dense array, next to the IDs of the entities owning them, while a sparse
+     * array indexed by entity index tells where the component of each entity is. Adding, removing and
+     * looking up a component all take constant time, and never involve any other component of the entity.
+     */
+    struct sparse_component_set_t
+    {
+    public:
+        sparse_component_set_t() = default;
+        sparse_component_set_t(const component_data& componentData);
+
+        inline size_t size() const { return m_entities.size(); }
+        inline component_id component_serial() const { return m_components.component_serial(); }
+
+        /**
+         * @brief Returns the IDs of the entities having the component, in the same order as their components.
+         */
+        inline std::span<const entity_id> entities() const { return m_entities; }
+
+        inline bool contains(const entity_id entity) const { return find_dense_index(entity) != INVALID_INDEX; }
+
+        /**
+         * @brief Adds a default-constructed component to the entity.
+         *
+         * @return Pointer to the added component, or to the existing one if the entity already has it.
+         */
+        void* add_component(const entity_id entity);
+
+        /**
+         * @brief Destroys the component of the entity, moving the last component of the set in its place.
+         *
+         * @return true if the entity had the component.
+         */
+        bool remove_component(const entity_id entity);
+
+        /**
+         * @brief Returns a pointer to the component of the entity, or nullptr if the entity doesn't have it.
+         *
+         * Tags have no data, so the returned pointer must not be dereferenced: it only tells that the entity
+         * has the tag.
+         */
+        void* find_component(const entity_id entity) const;
+
+        /**
+         * @brief Destroys all the components of the set.
+         */
+        void clear();
+
+        /**
+         * @brief Releases the memory not needed by the components currently in the set.
+         */
+        void shrink_to_fit();
+
+    private:
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+        /* Tags only need the dense entities array: no component is ever stored for them. */
+        inline bool is_tag() const { return m_components.component_size() == 0; }
+
+        /* Returns the index of the component of the entity in the dense arrays, or INVALID_INDEX. */
+        inline uint32_t find_dense_index(const entity_id entity) const
+        {
+            const size_t index = entity_index(entity);
+            if (index >= m_sparse.size())
+            {
+                return INVALID_INDEX;
+            }
+
+            // the entity ID also tells apart recycled entity indices
+            const uint32_t denseIndex = m_sparse[index];
+            return denseIndex < m_entities.size() && m_entities[denseIndex] == entity ? denseIndex : INVALID_INDEX;
+        }
+
+        /* The index in the dense arrays of the component of each entity, indexed by entity index. */
+        std::vector<uint32_t> m_sparse;
+
+        /* The entities having the component, in the same order as m_components. */
+        std::vector<entity_id> m_entities;
+        packed_component_array_t m_components;
+    };
+}
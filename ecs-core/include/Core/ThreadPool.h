@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ecs
+{
+    /**
+     * @brief A fixed set of worker threads running the tasks of parallel loops.
+     *
+     * ParallelFor() hands out task indices from a shared counter, so that threads finishing early keep 
+     * picking up work. The calling thread takes part in the loop as thread 0, so a pool with a single 
+     * thread has no workers at all and runs everything in place.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * @param numThreads The number of threads running the tasks, including the calling thread. 
+         *                   0 picks the number of hardware threads.
+         */
+        explicit ThreadPool(size_t numThreads = 0);
+        ThreadPool(const ThreadPool& other) = delete;
+        ~ThreadPool();
+
+        ThreadPool& operator=(const ThreadPool& other) = delete;
+
+        /**
+         * @brief Returns the number of threads running the tasks, including the calling thread.
+         */
+        inline size_t GetNumThreads() const { return m_workers.size() + 1; }
+
+        /**
+         * @brief Calls task(taskIndex, threadIndex) for each task index in [0, numTasks), spreading the tasks 
+         *        over all the threads, and returns once all of them have completed. Thread indices go from 0 
+         *        to GetNumThreads() - 1, and no two tasks run at the same time on the same thread index.
+         * @throw std::logic_error if called from the tasks of the same pool, which would deadlock.
+         * @throw Rethrows the first exception thrown by the tasks, once all the threads have stopped. The 
+         *        tasks not started yet are skipped.
+         */
+        void ParallelFor(const size_t numTasks, const std::function<void(size_t, size_t)>& task);
+
+    private:
+        void RunWorker(const size_t threadIndex);
+
+        /* Runs tasks until none is left. */
+        void RunTasks(const size_t threadIndex);
+
+        std::vector<std::thread> m_workers;
+
+        /* Serializes the loops started from different threads. */
+        std::mutex m_dispatchMutex;
+
+        std::mutex m_mutex;
+        std::condition_variable m_workAvailable;
+        std::condition_variable m_workDone;
+
+        /* The loop being run. Workers wake up when the generation changes. */
+        const std::function<void(size_t, size_t)>* m_task{nullptr};
+        size_t m_numTasks{0};
+        size_t m_generation{0};
+        size_t m_numBusyWorkers{0};
+        bool m_stopping{false};
+
+        std::atomic<size_t> m_nextTask{0};
+        std::exception_ptr m_exception;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <array>
+#include <cstdint>
 #include <unordered_map>
 #include <set>
 #include <vector>
@@ -11,6 +12,7 @@
 #include <cmath>
 #include <utility>
 #include "CompactString.h"
+#include "IDGenerator.h"
 #include "Containers/memory.h"
 #include "Containers/UnorderedMapPoolAllocator.h"
 #include "Containers/SetPoolAllocator.h"
@@ -18,6 +20,23 @@
 #define MAX_COMPONENTS 2048
 #define MAX_ENTITIES 20000
 
+/* Target size in bytes of a single archetype chunk. */
+#define ARCHETYPE_CHUNK_SIZE 16384
+
+#define CACHE_LINE_SIZE 64
+
+/* When non-zero, every component column of an archetype chunk starts on its own cache line, 
+   so that systems writing to different columns of the same chunk never share a line. */
+#ifndef PAD_COLUMNS_TO_CACHE_LINE
+#define PAD_COLUMNS_TO_CACHE_LINE 0
+#endif
+
+/* Address space each archetype reserves for its chunks when they are allocated from a virtual memory region. 
+   Only the pages actually used are committed, so this can be generous. */
+#ifndef CHUNK_REGION_RESERVE_SIZE
+#define CHUNK_REGION_RESERVE_SIZE (size_t(1) << 30)
+#endif
+
 namespace ecs
 {
     typedef float real_t;
@@ -25,7 +44,26 @@ namespace ecs
     typedef size_t entity_id;
     const static entity_id INVALID_ENTITY_ID = std::numeric_limits<entity_id>::max();
 
+    /* Entity IDs store the index of the entity slot in their low 32 bits and the generation of that 
+       slot in the high bits, so that the IDs of destroyed entities can be recycled safely. */
+    using entity_id_generator = GenerationalIDGenerator<entity_id, 32>;
+
+    inline constexpr size_t entity_index(const entity_id entity) 
+    { 
+        return entity_id_generator::GetIndex(entity); 
+    }
+
+    inline constexpr entity_id entity_generation(const entity_id entity) 
+    { 
+        return entity_id_generator::GetGeneration(entity); 
+    }
+
     typedef unsigned int archetype_id;
+    const static archetype_id INVALID_ARCHETYPE_ID = std::numeric_limits<archetype_id>::max();
+
+    /* Ticks order the changes made to components: the world advances the tick each time a system runs, 
+       so that systems can tell the changes made since their last run. 64 bits never wrap around. */
+    typedef uint64_t change_tick_t;
 
     /**
      * @brief A key for types.
@@ -1,14 +1,19 @@
 #pragma once
 
+#include <limits>
 #include <memory>
+#include <span>
 #include <unordered_map>
 #include <typeinfo>
 #include <type_traits>
 #include <typeindex>
+#include <utility>
+#include <vector>
 #include "Types.h"
 #include "IDGenerator.h"
 #include "ArchetypesRegistry.h"
 #include "ISystem.h"
+#include "ThreadPool.h"
 
 namespace ecs 
 { 
@@ -48,6 +53,109 @@ namespace ecs
 			return id;
 		}
 
+		/**
+		 * @brief Creates count entities with the given components at once. The archetype of the entities 
+		 * 		  is resolved only once, and its storage grows only once.
+		 * @tparam Components The components of the entities
+		 * @param count The number of entities to create
+		 * @param outEntities The span the IDs of the new entities are written to. Must hold at least count IDs.
+		 * @throw std::invalid_argument if outEntities is smaller than count.
+		 */
+		template<typename... Components>
+		void CreateEntities(const size_t count, std::span<entity_id> outEntities)
+		{
+			GenerateEntityIDs(count, outEntities);
+			m_archetypesRegistry->AddEntities<Components...>(outEntities.first(count));
+		}
+
+		/**
+		 * @brief Creates count entities with the given components at once, then initializes their components.
+		 * @tparam Components The components of the entities
+		 * @param count The number of entities to create
+		 * @param outEntities The span the IDs of the new entities are written to. Must hold at least count IDs.
+		 * @param initializer A callable invoked as initializer(index, Components&...) for each new entity, 
+		 * 		  where index goes from 0 to count - 1.
+		 * @throw std::invalid_argument if outEntities is smaller than count.
+		 */
+		template<typename... Components, typename InitializerFunction>
+		void CreateEntities(const size_t count, std::span<entity_id> outEntities, InitializerFunction&& initializer)
+		{
+			GenerateEntityIDs(count, outEntities);
+			m_archetypesRegistry->AddEntities<Components...>(outEntities.first(count), 
+				std::forward<InitializerFunction>(initializer));
+		}
+
+		/**
+		 * @brief Makes room for at least count entities with exactly the given components, so that 
+		 * 		  creating them does not allocate any memory. All the missing storage is allocated at once.
+		 * @tparam Components The components of the entities
+		 * @param count The total number of entities with these components the world should be able to hold
+		 */
+		template<typename... Components>
+		void Reserve(const size_t count)
+		{
+			m_archetypesRegistry->Reserve<Components...>(count);
+		}
+
+		/**
+		 * @brief Sets how the storage of the entities grows once the reserved room is used up.
+		 * @param growthPolicy The growth policy, applied to both existing and future archetypes
+		 */
+		void SetChunkGrowthPolicy(const chunk_growth_policy_t& growthPolicy);
+
+		/**
+		 * @brief Sets where the storage of the entities comes from. Only affects the archetypes created 
+		 * 		  afterwards, so it should be set before creating any entity.
+		 * @param chunkAllocator The allocator of the chunks of new archetypes
+		 */
+		void SetChunkAllocator(const EChunkAllocator chunkAllocator);
+
+		/**
+		 * @brief Sets the number of threads parallel queries run on, including the calling thread. 
+		 * 		  The threads are started again on next use.
+		 * @param numThreads The number of threads. 0 picks the number of hardware threads.
+		 */
+		void SetNumThreads(const size_t numThreads);
+
+		/**
+		 * @brief Gets the threads parallel queries run on, starting them on first use.
+		 */
+		ThreadPool& GetThreadPool();
+
+		/**
+		 * @brief Gives back the memory the world kept after a peak of entities: storage past the last 
+		 * 		  entity of each archetype is released, and archetypes without entities are forgotten, so 
+		 * 		  that queries stop visiting them. 
+		 * 		  The work can be spread over several frames by calling this method with a small budget 
+		 * 		  until it returns true.
+		 * @param budget The maximum number of archetypes to compact in this call.
+		 * @return true if all the archetypes have been compacted since the pass started.
+		 */
+		bool Compact(const size_t budget = std::numeric_limits<size_t>::max());
+
+		/**
+		 * @brief Destroys an entity and all of its components. The ID of the entity is recycled, 
+		 * 		  so handles to the destroyed entity become stale.
+		 * @param id The entity ID
+		 * @return true if the entity was alive and has been destroyed.
+		 */
+		bool DestroyEntity(entity_id id);
+
+		/**
+		 * @brief Destroys all the given entities at once. Entities are grouped by archetype, and the 
+		 * 		  storage of each archetype is compacted in a single pass.
+		 * @param ids The IDs of the entities. Stale and duplicated IDs are ignored.
+		 * @return The number of entities that have been destroyed.
+		 */
+		size_t DestroyEntities(std::span<const entity_id> ids);
+
+		/**
+		 * @brief Tells whether the given ID refers to an entity that has not been destroyed.
+		 * @param id The entity ID
+		 * @return true if the entity is alive.
+		 */
+		inline bool IsEntityAlive(entity_id id) const { return m_entityIDGenerator.IsAlive(id); }
+
 		/**
 		 * @brief 	Creates a handle for the entity with the given ID. 
 		 * 			A handle is a lightweight object that allows to access to utility APIs 
@@ -131,6 +239,76 @@ namespace ecs
 		 */
 		inline size_t GetSystemsCount() const noexcept { return m_registeredSystems.size();}
 
+		/**
+		 * @brief Creates the singleton of the given type, replacing the existing one if any. 
+		 * 		  Singletons hold global data (input, camera, configuration) which doesn't belong to any 
+		 * 		  entity, and never take part in queries.
+		 * @tparam SingletonType The type of the singleton.
+		 * @param args The arguments forwarded to the constructor of the singleton.
+		 * @return The new singleton.
+		 */
+		template<typename SingletonType, typename... Args>
+		SingletonType& SetSingleton(Args&&... args)
+		{
+			const size_t index = singleton_index_generator::GetTypeIndex<SingletonType>();
+			if (index >= m_singletons.size())
+			{
+				m_singletons.resize(index + 1);
+			}
+
+			std::shared_ptr<SingletonType> singleton = std::make_shared<SingletonType>(std::forward<Args>(args)...);
+			SingletonType& singletonRef = *singleton;
+			m_singletons[index] = std::move(singleton);
+			return singletonRef;
+		}
+
+		/**
+		 * @brief Gets the singleton of the given type in constant time.
+		 * @tparam SingletonType The type of the singleton.
+		 * @return The singleton.
+		 * @throw std::out_of_range if the singleton has not been set.
+		 */
+		template<typename SingletonType>
+		SingletonType& GetSingleton() const
+		{
+			if (SingletonType* singleton = FindSingleton<SingletonType>())
+			{
+				return *singleton;
+			}
+
+			throw std::out_of_range("Singleton not found. Call SetSingleton() first.");
+		}
+
+		/**
+		 * @brief Looks for the singleton of the given type in constant time.
+		 * @tparam SingletonType The type of the singleton.
+		 * @return The singleton if found, nullptr otherwise.
+		 */
+		template<typename SingletonType>
+		SingletonType* FindSingleton() const noexcept
+		{
+			const size_t index = singleton_index_generator::GetTypeIndex<SingletonType>();
+			return index < m_singletons.size() ? static_cast<SingletonType*>(m_singletons[index].get()) : nullptr;
+		}
+
+		/**
+		 * @brief Destroys the singleton of the given type.
+		 * @tparam SingletonType The type of the singleton.
+		 * @return true if the singleton existed.
+		 */
+		template<typename SingletonType>
+		bool RemoveSingleton()
+		{
+			const size_t index = singleton_index_generator::GetTypeIndex<SingletonType>();
+			if (index >= m_singletons.size() || m_singletons[index] == nullptr)
+			{
+				return false;
+			}
+
+			m_singletons[index].reset();
+			return true;
+		}
+
 		/**
 		 * @brief Updates the world, executing all the registered systems.
 		 * @param deltaTime The time since the last update.
@@ -138,11 +316,22 @@ namespace ecs
 		void Update(real_t deltaTime);
 
 	private:
+		using singleton_index_generator = TypeIndexGenerator<struct singleton_family>;
+
+		void GenerateEntityIDs(const size_t count, std::span<entity_id> outEntities);
+
 		std::shared_ptr<ArchetypesRegistry> m_archetypesRegistry;
 		std::shared_ptr<ComponentsRegistry> m_componentsRegistry;
 
-		IDGenerator<entity_id> m_entityIDGenerator;
+		entity_id_generator m_entityIDGenerator;
 
 		std::unordered_map<type_key, std::shared_ptr<ISystem>> m_registeredSystems;
+
+		/* The singletons of the world, indexed by their type index. */
+		std::vector<std::shared_ptr<void>> m_singletons;
+
+		/* The threads of parallel queries, started on first use. */
+		std::unique_ptr<ThreadPool> m_threadPool;
+		size_t m_numThreads{0};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "Containers/VirtualMemoryRegion.h"
+#include <algorithm>
+#include <cstdint>
+
+#if ECS_VIRTUAL_MEMORY_REGIONS
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+    size_t AlignUp(const size_t value, const size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+ecs::virtual_memory_region_t::virtual_memory_region_t(const size_t reservedSize, const bool useHugePages)
+{
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    m_commitGranularity = useHugePages ? HUGE_PAGE_SIZE : pageSize;
+    m_capacity = AlignUp(reservedSize, m_commitGranularity);
+
+    // reserve some more address space, so that the region can start on a huge page boundary
+    const size_t mappedSize = m_capacity + (useHugePages ? HUGE_PAGE_SIZE : 0);
+    void* mapping = mmap(nullptr, mappedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        m_capacity = 0;
+        return;
+    }
+
+    std::byte* mappingBegin = static_cast<std::byte*>(mapping);
+    m_data = mappingBegin;
+    if (useHugePages)
+    {
+        m_data = reinterpret_cast<std::byte*>(AlignUp(reinterpret_cast<uintptr_t>(mappingBegin), HUGE_PAGE_SIZE));
+        if (m_data != mappingBegin)
+        {
+            munmap(mappingBegin, m_data - mappingBegin);
+        }
+
+        std::byte* mappingEnd = mappingBegin + mappedSize;
+        if (m_data + m_capacity != mappingEnd)
+        {
+            munmap(m_data + m_capacity, mappingEnd - (m_data + m_capacity));
+        }
+
+        // only a hint: without transparent huge pages the region still works with regular pages
+        madvise(m_data, m_capacity, MADV_HUGEPAGE);
+    }
+}
+
+ecs::virtual_memory_region_t::~virtual_memory_region_t()
+{
+    if (m_data != nullptr)
+    {
+        munmap(m_data, m_capacity);
+    }
+}
+
+std::byte* ecs::virtual_memory_region_t::grow(const size_t size)
+{
+    if (m_data == nullptr || size > m_capacity - m_size)
+    {
+        return nullptr;
+    }
+
+    const size_t newSize = m_size + size;
+    if (newSize > m_committedSize)
+    {
+        const size_t newCommittedSize = std::min(AlignUp(newSize, m_commitGranularity), m_capacity);
+        if (mprotect(m_data + m_committedSize, newCommittedSize - m_committedSize, PROT_READ | PROT_WRITE) != 0)
+        {
+            return nullptr;
+        }
+
+        m_committedSize = newCommittedSize;
+    }
+
+    std::byte* newBytes = m_data + m_size;
+    m_size = newSize;
+    return newBytes;
+}
+
+void ecs::virtual_memory_region_t::shrink(const size_t size)
+{
+    if (size >= m_size)
+    {
+        return;
+    }
+
+    m_size = size;
+    const size_t newCommittedSize = AlignUp(m_size, m_commitGranularity);
+    if (newCommittedSize < m_committedSize)
+    {
+        madvise(m_data + newCommittedSize, m_committedSize - newCommittedSize, MADV_DONTNEED);
+        mprotect(m_data + newCommittedSize, m_committedSize - newCommittedSize, PROT_NONE);
+        m_committedSize = newCommittedSize;
+    }
+}
+
+#else
+
+ecs::virtual_memory_region_t::virtual_memory_region_t(const size_t /*reservedSize*/, const bool /*useHugePages*/)
+{
+
+}
+
+ecs::virtual_memory_region_t::~virtual_memory_region_t()
+{
+
+}
+
+std::byte* ecs::virtual_memory_region_t::grow(const size_t /*size*/)
+{
+    return nullptr;
+}
+
+void ecs::virtual_memory_region_t::shrink(const size_t /*size*/)
+{
+
+}
+
+#endif
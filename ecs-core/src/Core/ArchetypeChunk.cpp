@@ -0,0 +1,129 @@
+#include "Core/ArchetypeChunk.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    size_t AlignUp(const size_t value, const size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+ecs::chunk_layout_t::chunk_layout_t(const std::vector<component_data>& componentsData,
+    const size_t targetChunkSize, const bool padColumnsToCacheLine)
+{
+    const size_t minColumnAlignment = padColumnsToCacheLine ? CACHE_LINE_SIZE : alignof(std::max_align_t);
+
+    // every row stores at least the ID of its entity
+    size_t rowSize = sizeof(entity_id);
+    size_t maxPadding = 0;
+    size_t numEnableMasks = 0;
+    m_alignment = std::max(minColumnAlignment, alignof(entity_id));
+    m_columns.reserve(componentsData.size());
+    for (const component_data& componentData : componentsData)
+    {
+        if (componentData.is_tag() && !componentData.is_enableable())
+        {
+            continue;
+        }
+
+        // SoA components are laid out as one column per field, all the others as a single column
+        const component_field_t wholeComponent{ 0, componentData.data_size(), componentData.alignment(), 
+            componentData.ops() };
+        const std::span<const component_field_t> fields = componentData.is_soa() ? componentData.fields() 
+            : std::span<const component_field_t>(&wholeComponent, 1);
+        for (size_t fieldIndex = 0; fieldIndex < fields.size(); ++fieldIndex)
+        {
+            chunk_column_t column;
+            column.componentID = componentData.serial();
+            column.fieldIndex = static_cast<uint16_t>(fieldIndex);
+            column.componentSize = fields[fieldIndex].size;
+            column.alignment = std::max(minColumnAlignment, fields[fieldIndex].alignment);
+            column.ops = fields[fieldIndex].ops;
+            rowSize += column.componentSize;
+
+            // leave room for the padding that aligns the beginning of each column
+            maxPadding += column.alignment - 1;
+            m_alignment = std::max(m_alignment, column.alignment);
+
+            if (componentData.is_enableable() && fieldIndex == 0)
+            {
+                // the actual offset is known only once all the columns have been laid out
+                column.enableMaskOffset = std::numeric_limits<size_t>::max();
+
+                // masks are rounded up to whole words
+                numEnableMasks += 1;
+                maxPadding += alignof(uint64_t) - 1 + sizeof(uint64_t);
+            }
+
+            m_columns.push_back(column);
+        }
+    }
+
+    std::sort(m_columns.begin(), m_columns.end(), [](const chunk_column_t& a, const chunk_column_t& b)
+    {
+        return a.componentID != b.componentID ? a.componentID < b.componentID : a.fieldIndex < b.fieldIndex;
+    });
+
+    static_assert(MAX_COMPONENTS <= std::numeric_limits<uint16_t>::max(), "Column indices must fit 16 bits");
+    if (!m_columns.empty())
+    {
+        m_columnIndices.assign(static_cast<size_t>(m_columns.back().componentID) + 1, 
+            static_cast<uint16_t>(m_columns.size()));
+        for (size_t columnIndex = 0; columnIndex < m_columns.size(); ++columnIndex)
+        {
+            if (m_columns[columnIndex].fieldIndex == 0)
+            {
+                m_columnIndices[m_columns[columnIndex].componentID] = static_cast<uint16_t>(columnIndex);
+            }
+        }
+    }
+
+    // each enable mask takes a single bit per row
+    m_rowsPerChunk = targetChunkSize > maxPadding ? (targetChunkSize - maxPadding) * 8 / (rowSize * 8 + numEnableMasks) : 0;
+    m_rowsPerChunk = std::max<size_t>(m_rowsPerChunk, 1);
+
+    size_t offset = sizeof(entity_id) * m_rowsPerChunk;
+    for (chunk_column_t& column : m_columns)
+    {
+        offset = AlignUp(offset, column.alignment);
+        column.offset = offset;
+        offset += column.componentSize * m_rowsPerChunk;
+    }
+
+    for (chunk_column_t& column : m_columns)
+    {
+        if (column.is_enableable())
+        {
+            offset = AlignUp(offset, alignof(uint64_t));
+            column.enableMaskOffset = offset;
+            offset += num_enable_mask_words() * sizeof(uint64_t);
+        }
+    }
+
+    // rows bigger than a chunk get a chunk big enough to hold exactly one of them
+    m_chunkSize = std::max(targetChunkSize, offset);
+    m_chunkStride = AlignUp(m_chunkSize, m_alignment);
+}
+
+const ecs::chunk_column_t& ecs::chunk_layout_t::tag_column()
+{
+    static const chunk_column_t tagColumn{ 0, 0, 1, 0, component_ops_t(), chunk_column_t::NO_ENABLE_MASK };
+    return tagColumn;
+}
+
+size_t ecs::chunk_growth_policy_t::get_num_chunks_to_allocate(const size_t numAllocatedChunks) const
+{
+    const size_t numGrowthChunks = static_cast<size_t>(std::ceil(numAllocatedChunks * growthFactor));
+    return std::max<size_t>({ minChunksPerAllocation, numGrowthChunks, 1 });
+}
+
+ecs::chunk_block_t::chunk_block_t(const chunk_layout_t& layout, const size_t numChunks)
+    : m_data(nullptr, block_deleter{layout.alignment()}), m_numChunks(numChunks),
+    m_chunkStride(layout.chunk_stride())
+{
+    m_data.reset(static_cast<std::byte*>(::operator new[](m_chunkStride * m_numChunks, 
+        std::align_val_t(layout.alignment()))));
+}
@@ -20,7 +20,11 @@ ecs::archetype::archetype(std::initializer_list<ecs::component_data> componentsD
 {
     for (auto componentDataIt = componentsData.begin(); componentDataIt != componentsData.end(); ++componentDataIt)
     {
-        m_componentIDs.insert((*componentDataIt).serial());
+        // components stored in sparse sets are not part of any archetype
+        if (!(*componentDataIt).is_sparse())
+        {
+            m_componentIDs.insert((*componentDataIt).serial());
+        }
     }
 }
 
@@ -1,13 +1,19 @@
 #include "Core/ArchetypesRegistry.h"
 #include "Core/World.h"
 #include <algorithm>
+#include <cassert>
+#include <cstring>
 
 
 ecs::ArchetypesRegistry::archetype_set::archetype_set(const ecs::archetype& archetype, 
-    ecs::ComponentsRegistry* componentsRegistry)
+    ecs::ComponentsRegistry* componentsRegistry, const ecs::chunk_growth_policy_t& growthPolicy,
+    const EChunkAllocator chunkAllocator)
 {
     m_archetype = archetype;
+    m_growthPolicy = growthPolicy;
 
+    std::vector<component_data> componentsData;
+    componentsData.reserve(m_archetype.get_num_components());
     for (auto componentIt = m_archetype.begin(); componentIt != m_archetype.end(); ++componentIt)
     {
         ecs::component_data componentData;
@@ -17,115 +23,609 @@ ecs::ArchetypesRegistry::archetype_set::archetype_set(const ecs::archetype& arch
             throw std::invalid_argument("Component not found in the database. Call RegisterComponent() first.");
         }
         
-        m_componentArraysMap.emplace(componentData.serial(), std::make_shared<packed_component_array_t>(componentData));
+        componentsData.push_back(componentData);
     }
+
+    m_layout = chunk_layout_t(componentsData);
+
+    if (chunkAllocator == EChunkAllocator::HugePages)
+    {
+        m_region = std::make_unique<virtual_memory_region_t>(CHUNK_REGION_RESERVE_SIZE, true);
+        if (!m_region->is_valid())
+        {
+            m_region.reset();
+        }
+    }
+}
+
+ecs::ArchetypesRegistry::archetype_set::archetype_set(archetype_set&& other) noexcept
+    : m_archetype(std::move(other.m_archetype)), m_layout(std::move(other.m_layout)), 
+    m_growthPolicy(other.m_growthPolicy), m_region(std::move(other.m_region)), m_blocks(std::move(other.m_blocks)), m_chunks(std::move(other.m_chunks)), 
+    m_numEntities(std::exchange(other.m_numEntities, 0)), m_columnTicks(std::move(other.m_columnTicks)), m_addEdges(std::move(other.m_addEdges)), 
+    m_removeEdges(std::move(other.m_removeEdges))
+{
+
+}
+
+ecs::ArchetypesRegistry::archetype_set& ecs::ArchetypesRegistry::archetype_set::operator=(archetype_set&& other) noexcept
+{
+    if (this != &other)
+    {
+        destroy_rows();
+        m_archetype = std::move(other.m_archetype);
+        m_layout = std::move(other.m_layout);
+        m_growthPolicy = other.m_growthPolicy;
+        m_region = std::move(other.m_region);
+        m_blocks = std::move(other.m_blocks);
+        m_chunks = std::move(other.m_chunks);
+        m_numEntities = std::exchange(other.m_numEntities, 0);
+        m_columnTicks = std::move(other.m_columnTicks);
+        m_addEdges = std::move(other.m_addEdges);
+        m_removeEdges = std::move(other.m_removeEdges);
+    }
+
+    return *this;
+}
+
+ecs::ArchetypesRegistry::archetype_set::~archetype_set()
+{
+    destroy_rows();
+}
+
+void ecs::ArchetypesRegistry::archetype_set::destroy_rows()
+{
+    if (m_numEntities == 0)
+    {
+        return;
+    }
+
+    for (size_t chunkIndex = 0; chunkIndex < get_num_chunks(); ++chunkIndex)
+    {
+        const size_t numEntitiesInChunk = get_num_entities_in_chunk(chunkIndex);
+        for (const chunk_column_t& column : m_layout.columns())
+        {
+            destroy_components(column.ops, m_chunks[chunkIndex].column_data(column), numEntitiesInChunk);
+        }
+    }
+
+    m_numEntities = 0;
 }
 
-size_t ecs::ArchetypesRegistry::archetype_set::add_entity(entity_id entity)
+size_t ecs::ArchetypesRegistry::archetype_set::shrink_to_fit()
 {
-    size_t entityIndex = 0;
-    for (auto packedArrayIt = m_componentArraysMap.begin(); packedArrayIt != m_componentArraysMap.end(); ++packedArrayIt)
+    const size_t numUsedChunks = get_num_chunks();
+    const size_t numAllocatedChunks = m_chunks.size();
+
+    // blocks past the last used chunk are released as a whole
+    while (!m_blocks.empty() && m_chunks.size() - m_blocks.back().num_chunks() >= numUsedChunks)
+    {
+        m_chunks.resize(m_chunks.size() - m_blocks.back().num_chunks());
+        m_blocks.pop_back();
+    }
+
+    // without blocks, the remaining chunks come from the region, which shrinks in place
+    if (m_chunks.size() > numUsedChunks && m_blocks.empty())
     {
-        entityIndex = packedArrayIt->second->size();
-        packedArrayIt->second->add_component();
+        m_region->shrink(m_layout.chunk_stride() * numUsedChunks);
+        m_chunks.resize(numUsedChunks);
+    }
+
+    // the last block may still be partially used
+    if (m_chunks.size() > numUsedChunks)
+    {
+        const size_t firstChunkIndex = m_chunks.size() - m_blocks.back().num_chunks();
+        chunk_block_t block(m_layout, numUsedChunks - firstChunkIndex);
+        for (size_t chunkIndex = firstChunkIndex; chunkIndex < numUsedChunks; ++chunkIndex)
+        {
+            const archetype_chunk_t newChunk = block.get_chunk(chunkIndex - firstChunkIndex);
+            relocate_chunk(newChunk, m_chunks[chunkIndex], get_num_entities_in_chunk(chunkIndex));
+            m_chunks[chunkIndex] = newChunk;
+        }
+
+        m_chunks.resize(numUsedChunks);
+        m_blocks.back() = std::move(block);
     }
 
-    m_entityToIndexMap[entity] = entityIndex;
-    m_indexToEntityMap[entityIndex] = entity;
+    m_chunks.shrink_to_fit();
+    m_blocks.shrink_to_fit();
+    m_columnTicks.resize(m_chunks.size() * m_layout.num_columns());
+    m_columnTicks.shrink_to_fit();
+    return numAllocatedChunks - m_chunks.size();
+}
+
+void ecs::ArchetypesRegistry::archetype_set::relocate_chunk(const archetype_chunk_t& destination, 
+    const archetype_chunk_t& source, const size_t numRows) const
+{
+    std::copy_n(source.entities(), numRows, destination.entities());
+    for (const chunk_column_t& column : m_layout.columns())
+    {
+        move_components(column.ops, column.componentSize, destination.column_data(column), 
+            source.column_data(column), numRows);
+        if (column.is_enableable())
+        {
+            std::copy_n(source.enable_mask(column), m_layout.num_enable_mask_words(), destination.enable_mask(column));
+        }
+    }
+}
+
+void ecs::ArchetypesRegistry::archetype_set::remove_edges_to(const archetype_id archetypeID)
+{
+    const auto leadsToArchetype = [archetypeID](const archetype_edge_t& edge) 
+    { 
+        return edge.targetArchetypeID == archetypeID; 
+    };
+
+    std::erase_if(m_addEdges, leadsToArchetype);
+    std::erase_if(m_removeEdges, leadsToArchetype);
+}
+
+size_t ecs::ArchetypesRegistry::archetype_set::add_row(entity_id entity)
+{
+    if (m_numEntities == get_capacity())
+    {
+        allocate_chunks(m_growthPolicy.get_num_chunks_to_allocate(m_chunks.size()));
+    }
+
+    const size_t entityIndex = m_numEntities++;
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    m_chunks[entityIndex / rowsPerChunk].entities()[entityIndex % rowsPerChunk] = entity;
+    enable_rows(entityIndex, 1);
     return entityIndex;
 }
 
-size_t ecs::ArchetypesRegistry::archetype_set::get_entity_index(entity_id entity) const
+void ecs::ArchetypesRegistry::archetype_set::enable_rows(const size_t firstIndex, const size_t count)
 {
-    return m_entityToIndexMap.at(entity);
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    const archetype_chunk_t& chunk = m_chunks[firstIndex / rowsPerChunk];
+    const size_t firstRow = firstIndex % rowsPerChunk;
+    for (const chunk_column_t& column : m_layout.columns())
+    {
+        if (column.is_enableable())
+        {
+            for (size_t row = firstRow; row < firstRow + count; ++row)
+            {
+                chunk.set_enabled(column, row, true);
+            }
+        }
+    }
 }
 
-bool ecs::ArchetypesRegistry::archetype_set::try_get_entity_index(entity_id entity, size_t& index) const
+void ecs::ArchetypesRegistry::archetype_set::mark_added(const size_t index, const change_tick_t tick)
 {
-    auto optionalIndex = m_entityToIndexMap.find(entity);
-    if (optionalIndex != m_entityToIndexMap.end())
+    const size_t chunkIndex = index / m_layout.rows_per_chunk();
+    for (size_t columnIndex = 0; columnIndex < m_layout.num_columns(); ++columnIndex)
     {
-        index = optionalIndex->second;
-        return true;
+        column_ticks_t& ticks = get_column_ticks(chunkIndex, columnIndex);
+        ticks.added = tick;
+        ticks.changed = tick;
+    }
+}
+
+void ecs::ArchetypesRegistry::archetype_set::mark_changed(const component_id componentID, const size_t index, 
+    const change_tick_t tick)
+{
+    const size_t columnIndex = find_column_index(componentID);
+    if (columnIndex < m_layout.num_columns())
+    {
+        get_column_ticks(index / m_layout.rows_per_chunk(), columnIndex).changed = tick;
+    }
+}
+
+void ecs::ArchetypesRegistry::archetype_set::allocate_chunks(const size_t numChunks)
+{
+    m_columnTicks.resize((m_chunks.size() + numChunks) * m_layout.num_columns());
+
+    // the region only grows while it holds all the chunks, so that chunks stay in allocation order
+    if (m_region != nullptr && m_blocks.empty())
+    {
+        if (std::byte* data = m_region->grow(m_layout.chunk_stride() * numChunks))
+        {
+            for (size_t chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex)
+            {
+                m_chunks.emplace_back(data + m_layout.chunk_stride() * chunkIndex);
+            }
+            return;
+        }
+    }
+
+    const chunk_block_t& block = m_blocks.emplace_back(m_layout, numChunks);
+    for (size_t chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex)
+    {
+        m_chunks.push_back(block.get_chunk(chunkIndex));
+    }
+}
+
+void ecs::ArchetypesRegistry::archetype_set::reserve(const size_t numEntities)
+{
+    if (numEntities > get_capacity())
+    {
+        const size_t rowsPerChunk = m_layout.rows_per_chunk();
+        const size_t numRequiredChunks = (numEntities + rowsPerChunk - 1) / rowsPerChunk;
+        allocate_chunks(numRequiredChunks - m_chunks.size());
+    }
+}
+
+size_t ecs::ArchetypesRegistry::archetype_set::add_entity(entity_id entity, const change_tick_t tick)
+{
+    const size_t entityIndex = add_row(entity);
+    for (size_t columnIndex = 0; columnIndex < m_layout.num_columns(); ++columnIndex)
+    {
+        construct_components(m_layout.column(columnIndex).ops, get_component_in_column(columnIndex, entityIndex), 1);
+    }
+    mark_added(entityIndex, tick);
+
+    return entityIndex;
+}
+
+size_t ecs::ArchetypesRegistry::archetype_set::add_entities(std::span<const entity_id> entities, 
+    const change_tick_t tick)
+{
+    const size_t firstRow = m_numEntities;
+    reserve(m_numEntities + entities.size());
+
+    // fill the new rows one chunk at a time
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    size_t numAddedEntities = 0;
+    while (numAddedEntities < entities.size())
+    {
+        const size_t row = m_numEntities;
+        const size_t rowInChunk = row % rowsPerChunk;
+        const size_t numRows = std::min(rowsPerChunk - rowInChunk, entities.size() - numAddedEntities);
+        const archetype_chunk_t& chunk = m_chunks[row / rowsPerChunk];
+
+        std::copy_n(entities.data() + numAddedEntities, numRows, chunk.entities() + rowInChunk);
+        for (const chunk_column_t& column : m_layout.columns())
+        {
+            construct_components(column.ops, chunk.get_component(column, rowInChunk), numRows);
+        }
+        enable_rows(row, numRows);
+        mark_added(row, tick);
+
+        m_numEntities += numRows;
+        numAddedEntities += numRows;
+    }
+
+    return firstRow;
+}
+
+ecs::entity_id ecs::ArchetypesRegistry::archetype_set::get_entity_at_index(const size_t index) const
+{
+    if (index >= m_numEntities)
+    {
+        throw std::out_of_range("Index out of bounds");
+    }
+
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    return m_chunks[index / rowsPerChunk].entities()[index % rowsPerChunk];
+}
+
+size_t ecs::ArchetypesRegistry::archetype_set::get_num_entities_in_chunk(const size_t chunkIndex) const
+{
+    const size_t firstRow = chunkIndex * m_layout.rows_per_chunk();
+    if (firstRow >= m_numEntities)
+    {
+        return 0;
+    }
+
+    return std::min(m_layout.rows_per_chunk(), m_numEntities - firstRow);
+}
+
+void* ecs::ArchetypesRegistry::archetype_set::get_component_in_column(const size_t columnIndex, 
+    const size_t index) const
+{
+    if (index >= m_numEntities)
+    {
+        throw std::out_of_range("Index out of bounds");
     }
 
-    return false;
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    return m_chunks[index / rowsPerChunk].get_component(m_layout.column(columnIndex), index % rowsPerChunk);
+}
+
+const ecs::chunk_column_t& ecs::ArchetypesRegistry::archetype_set::get_column(const component_id componentID) const
+{
+    const size_t columnIndex = find_column_index(componentID);
+    if (columnIndex < m_layout.num_columns())
+    {
+        return m_layout.column(columnIndex);
+    }
+
+    if (m_archetype.has_component(componentID))
+    {
+        return chunk_layout_t::tag_column();
+    }
+
+    throw std::out_of_range("Component not found in archetype");
+}
+
+const ecs::chunk_column_t* ecs::ArchetypesRegistry::archetype_set::find_column(const component_id componentID) const
+{
+    const size_t columnIndex = find_column_index(componentID);
+    if (columnIndex < m_layout.num_columns())
+    {
+        return &m_layout.column(columnIndex);
+    }
+
+    return m_archetype.has_component(componentID) ? &chunk_layout_t::tag_column() : nullptr;
 }
 
 void* ecs::ArchetypesRegistry::archetype_set::get_component_at_index(const component_id componentID, const size_t index) const
 {
-    std::shared_ptr<packed_component_array_t> packedArray = m_componentArraysMap.at(componentID);
-    if (packedArray.get() != nullptr)
+    const chunk_column_t& column = get_column(componentID);
+    if (index >= m_numEntities)
     {
-        return packedArray->get_component(index);
+        throw std::out_of_range("Index out of bounds");
     }
 
-    throw std::runtime_error("Found a null packed_component_array");
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    return m_chunks[index / rowsPerChunk].get_component(column, index % rowsPerChunk);
 }
 
 void* ecs::ArchetypesRegistry::archetype_set::find_component_at_index(const component_id componentID, const size_t index) const
 {
-    auto optionalArray = m_componentArraysMap.find(componentID);
-    if (optionalArray != m_componentArraysMap.end())
+    if (!m_archetype.has_component(componentID) || index >= m_numEntities)
+    {
+        return nullptr;
+    }
+
+    return get_component_at_index(componentID, index);
+}
+
+void ecs::ArchetypesRegistry::archetype_set::set_component_enabled(const component_id componentID, 
+    const size_t index, const bool enabled)
+{
+    const chunk_column_t& column = get_column(componentID);
+    if (!column.is_enableable())
+    {
+        throw std::logic_error("Component is not enableable. Register it as enableable first.");
+    }
+
+    if (index >= m_numEntities)
+    {
+        throw std::out_of_range("Index out of bounds");
+    }
+
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    m_chunks[index / rowsPerChunk].set_enabled(column, index % rowsPerChunk, enabled);
+}
+
+bool ecs::ArchetypesRegistry::archetype_set::is_component_enabled(const component_id componentID, 
+    const size_t index) const
+{
+    const chunk_column_t& column = get_column(componentID);
+    if (index >= m_numEntities)
+    {
+        throw std::out_of_range("Index out of bounds");
+    }
+
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    return !column.is_enableable() || m_chunks[index / rowsPerChunk].is_enabled(column, index % rowsPerChunk);
+}
+
+void ecs::ArchetypesRegistry::archetype_set::move_rows(const size_t destinationIndex, const size_t sourceIndex,
+    const size_t count)
+{
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    const archetype_chunk_t& destinationChunk = m_chunks[destinationIndex / rowsPerChunk];
+    const archetype_chunk_t& sourceChunk = m_chunks[sourceIndex / rowsPerChunk];
+    const size_t destinationRow = destinationIndex % rowsPerChunk;
+    const size_t sourceRow = sourceIndex % rowsPerChunk;
+
+    // the destination chunk now holds the changes of the moved rows as well
+    const size_t destinationChunkIndex = destinationIndex / rowsPerChunk;
+    const size_t sourceChunkIndex = sourceIndex / rowsPerChunk;
+    for (size_t columnIndex = 0; destinationChunkIndex != sourceChunkIndex && columnIndex < m_layout.num_columns(); 
+        ++columnIndex)
+    {
+        column_ticks_t& destinationTicks = get_column_ticks(destinationChunkIndex, columnIndex);
+        const column_ticks_t& sourceTicks = get_column_ticks(sourceChunkIndex, columnIndex);
+        destinationTicks.added = std::max(destinationTicks.added, sourceTicks.added);
+        destinationTicks.changed = std::max(destinationTicks.changed, sourceTicks.changed);
+    }
+
+    std::copy_n(sourceChunk.entities() + sourceRow, count, destinationChunk.entities() + destinationRow);
+    for (const chunk_column_t& column : m_layout.columns())
     {
-        std::shared_ptr<packed_component_array_t> packedArray = optionalArray->second;
-        if (packedArray.get() != nullptr)
+        move_components(column.ops, column.componentSize, destinationChunk.get_component(column, destinationRow),
+            sourceChunk.get_component(column, sourceRow), count);
+
+        if (column.is_enableable())
         {
-            return packedArray->get_component(index);
+            for (size_t i = 0; i < count; ++i)
+            {
+                destinationChunk.set_enabled(column, destinationRow + i, sourceChunk.is_enabled(column, sourceRow + i));
+            }
         }
     }
+}
 
-    return nullptr;
+ecs::entity_id ecs::ArchetypesRegistry::archetype_set::remove_at(const size_t index, const bool destroyComponents)
+{
+    if (destroyComponents)
+    {
+        for (size_t columnIndex = 0; columnIndex < m_layout.num_columns(); ++columnIndex)
+        {
+            destroy_components(m_layout.column(columnIndex).ops, get_component_in_column(columnIndex, index), 1);
+        }
+    }
+
+    // fill the hole with the last row of the archetype, so that rows stay packed
+    const size_t lastIndex = m_numEntities - 1;
+    entity_id movedEntity = INVALID_ENTITY_ID;
+    if (index != lastIndex)
+    {
+        movedEntity = get_entity_at_index(lastIndex);
+        move_rows(index, lastIndex, 1);
+    }
+
+    m_numEntities -= 1;
+    return movedEntity;
 }
 
-void ecs::ArchetypesRegistry::archetype_set::remove_entity(ecs::entity_id entity)
+void ecs::ArchetypesRegistry::archetype_set::remove_rows(std::span<const size_t> sortedIndices)
 {
-    auto optionalIndex = m_entityToIndexMap.find(entity);
-    if (optionalIndex == m_entityToIndexMap.end())
+    const size_t numRemovedRows = sortedIndices.size();
+    if (numRemovedRows == 0)
     {
         return;
     }
 
-    const size_t index = optionalIndex->second;
-    const size_t lastIndex = m_entityToIndexMap.size() - 1;
-    for (auto packedArrayIt = m_componentArraysMap.begin(); packedArrayIt != m_componentArraysMap.end(); ++packedArrayIt)
+    for (const size_t index : sortedIndices)
     {
-        packedArrayIt->second->delete_at(index);
+        for (size_t columnIndex = 0; columnIndex < m_layout.num_columns(); ++columnIndex)
+        {
+            destroy_components(m_layout.column(columnIndex).ops, get_component_in_column(columnIndex, index), 1);
+        }
     }
 
-    const entity_id lastEntity = m_indexToEntityMap[lastIndex];
-    m_indexToEntityMap.erase(lastIndex);
-    m_entityToIndexMap.erase(entity);
-    if (entity != lastEntity)
+    // removed rows below the new size are holes, the others are already past the end of the archetype
+    const size_t newNumEntities = m_numEntities - numRemovedRows;
+    const size_t numHoles = static_cast<size_t>(std::lower_bound(sortedIndices.begin(), sortedIndices.end(), 
+        newNumEntities) - sortedIndices.begin());
+
+    const size_t rowsPerChunk = m_layout.rows_per_chunk();
+    size_t holeIndex = 0;
+    size_t sourceIndex = newNumEntities;
+    size_t nextRemovedIndex = numHoles;
+    while (holeIndex < numHoles)
     {
-        m_entityToIndexMap[lastEntity] = index;
-        m_indexToEntityMap[index] = lastEntity;
+        // skip the removed rows at the end of the archetype
+        while (nextRemovedIndex < numRemovedRows && sortedIndices[nextRemovedIndex] == sourceIndex)
+        {
+            ++nextRemovedIndex;
+            ++sourceIndex;
+        }
+
+        // grow the run while both holes and surviving rows stay consecutive and inside their chunks
+        const size_t destinationIndex = sortedIndices[holeIndex];
+        const size_t maxRunLength = std::min(rowsPerChunk - destinationIndex % rowsPerChunk, 
+            rowsPerChunk - sourceIndex % rowsPerChunk);
+        size_t runLength = 1;
+        while (runLength < maxRunLength && holeIndex + runLength < numHoles
+            && sortedIndices[holeIndex + runLength] == destinationIndex + runLength
+            && (nextRemovedIndex == numRemovedRows || sortedIndices[nextRemovedIndex] != sourceIndex + runLength))
+        {
+            ++runLength;
+        }
+
+        move_rows(destinationIndex, sourceIndex, runLength);
+        holeIndex += runLength;
+        sourceIndex += runLength;
     }
+
+    m_numEntities = newNumEntities;
 }
 
-void ecs::ArchetypesRegistry::archetype_set::copy_entity_to(const entity_id entity, archetype_set& destination)
+size_t ecs::ArchetypesRegistry::archetype_set::move_entity_to(const size_t entityIndexInSource, 
+    archetype_set& destination, const std::vector<size_t>& columnMapping, const change_tick_t tick)
 {
-    destination.add_entity(entity);
+    const size_t entityIndexInDestination = destination.add_row(get_entity_at_index(entityIndexInSource));
+    const size_t numDestinationColumns = destination.m_layout.num_columns();
+    const size_t sourceChunkIndex = entityIndexInSource / m_layout.rows_per_chunk();
+    const size_t destinationChunkIndex = entityIndexInDestination / destination.m_layout.rows_per_chunk();
 
-    for (auto componentIt = m_archetype.begin(); componentIt != m_archetype.end(); ++componentIt)
+    for (size_t columnIndex = 0; columnIndex < m_layout.num_columns(); ++columnIndex)
     {
-        if (!destination.get_archetype().has_component(*componentIt))
+        const chunk_column_t& column = m_layout.column(columnIndex);
+        void* sourceComponent = get_component_in_column(columnIndex, entityIndexInSource);
+        const size_t destinationColumnIndex = columnMapping[columnIndex];
+        if (destinationColumnIndex == numDestinationColumns)
         {
+            destroy_components(column.ops, sourceComponent, 1);
             continue;
         }
 
-        std::shared_ptr<packed_component_array_t> sourceComponentArray = m_componentArraysMap.at(*componentIt);
-        std::shared_ptr<packed_component_array_t> targetComponentArray = destination.m_componentArraysMap.at(*componentIt);
+        move_components(column.ops, column.componentSize, 
+            destination.get_component_in_column(destinationColumnIndex, entityIndexInDestination), sourceComponent, 1);
+
+        // moved components keep their changes, which the destination chunk now holds as well
+        column_ticks_t& destinationTicks = destination.get_column_ticks(destinationChunkIndex, destinationColumnIndex);
+        const column_ticks_t& sourceTicks = get_column_ticks(sourceChunkIndex, columnIndex);
+        destinationTicks.added = std::max(destinationTicks.added, sourceTicks.added);
+        destinationTicks.changed = std::max(destinationTicks.changed, sourceTicks.changed);
+
+        // the destination row starts with everything enabled, disabled components stay disabled
+        if (column.is_enableable() && !is_component_enabled(column.componentID, entityIndexInSource))
+        {
+            destination.set_component_enabled(column.componentID, entityIndexInDestination, false);
+        }
+    }
 
-        const size_t entityIndexInSource = get_entity_index(entity);
-        sourceComponentArray->copy_to(entityIndexInSource, *targetComponentArray.get(),
-                                      targetComponentArray->size() - 1);
+    // the components the source archetype doesn't have start from their default value
+    for (size_t columnIndex = 0; columnIndex < numDestinationColumns; ++columnIndex)
+    {
+        const chunk_column_t& column = destination.m_layout.column(columnIndex);
+        if (!m_archetype.has_component(column.componentID))
+        {
+            construct_components(column.ops, destination.get_component_in_column(columnIndex, entityIndexInDestination), 1);
+            column_ticks_t& ticks = destination.get_column_ticks(destinationChunkIndex, columnIndex);
+            ticks.added = tick;
+            ticks.changed = tick;
+        }
     }
+
+    return entityIndexInDestination;
+}
+
+std::vector<size_t> ecs::ArchetypesRegistry::archetype_set::make_column_mapping(const archetype_set& destination) const
+{
+    std::vector<size_t> columnMapping(m_layout.num_columns());
+    for (size_t columnIndex = 0; columnIndex < m_layout.num_columns(); ++columnIndex)
+    {
+        // the fields of SoA components map to the column of the same field
+        const chunk_column_t& column = m_layout.column(columnIndex);
+        const size_t destinationColumnIndex = destination.find_column_index(column.componentID);
+        columnMapping[columnIndex] = destinationColumnIndex < destination.m_layout.num_columns() 
+            ? destinationColumnIndex + column.fieldIndex : destinationColumnIndex;
+    }
+
+    return columnMapping;
+}
+
+const ecs::ArchetypesRegistry::archetype_edge_t* ecs::ArchetypesRegistry::archetype_set::find_add_edge(
+    const component_id componentID) const
+{
+    for (const archetype_edge_t& edge : m_addEdges)
+    {
+        if (edge.componentID == componentID)
+        {
+            return &edge;
+        }
+    }
+
+    return nullptr;
+}
+
+const ecs::ArchetypesRegistry::archetype_edge_t* ecs::ArchetypesRegistry::archetype_set::find_remove_edge(
+    const component_id componentID) const
+{
+    for (const archetype_edge_t& edge : m_removeEdges)
+    {
+        if (edge.componentID == componentID)
+        {
+            return &edge;
+        }
+    }
+
+    return nullptr;
+}
+
+const ecs::ArchetypesRegistry::archetype_edge_t& ecs::ArchetypesRegistry::archetype_set::set_add_edge(
+    archetype_edge_t&& edge)
+{
+    return m_addEdges.emplace_back(std::move(edge));
+}
+
+const ecs::ArchetypesRegistry::archetype_edge_t& ecs::ArchetypesRegistry::archetype_set::set_remove_edge(
+    archetype_edge_t&& edge)
+{
+    return m_removeEdges.emplace_back(std::move(edge));
 }
 
 void ecs::ArchetypesRegistry::AddEntity(ecs::entity_id entity, std::initializer_list<ecs::component_data> componentsData)
 {
     AddEntity(entity, archetype(componentsData));
+    AddSparseComponents(std::span<const entity_id>(&entity, 1), componentsData);
 }
 
 void ecs::ArchetypesRegistry::AddEntity(entity_id entity, const ecs::archetype& archetype)
@@ -135,134 +635,507 @@ void ecs::ArchetypesRegistry::AddEntity(entity_id entity, const ecs::archetype&
 
     // Add the entity to the archetype set.
     archetype_set& archetypeSet = m_archetypeSets[id];
-    archetypeSet.add_entity(entity);
+    const size_t row = archetypeSet.add_entity(entity, m_changeTick);
+
+    // remember where the entity has been stored.
+    SetEntityLocation(entity, id, row);
+}
+
+ecs::archetype_id ecs::ArchetypesRegistry::AddEntitiesToArchetype(std::span<const entity_id> entities, 
+    const ecs::archetype& archetype)
+{
+    const archetype_id id = GetOrCreateArchetypeID(archetype);
+    const size_t firstRow = m_archetypeSets[id].add_entities(entities, m_changeTick);
+    for (size_t index = 0; index < entities.size(); ++index)
+    {
+        SetEntityLocation(entities[index], id, firstRow + index);
+    }
+
+    return id;
+}
+
+void ecs::ArchetypesRegistry::AddSparseComponents(std::span<const entity_id> entities, 
+    std::initializer_list<component_data> componentsData)
+{
+    for (const component_data& componentData : componentsData)
+    {
+        if (componentData.is_sparse())
+        {
+            sparse_component_set_t& sparseSet = GetOrCreateSparseSet(componentData.serial());
+            for (const entity_id entity : entities)
+            {
+                sparseSet.add_component(entity);
+            }
+        }
+    }
+}
+
+ecs::sparse_component_set_t& ecs::ArchetypesRegistry::GetOrCreateSparseSet(const component_id componentID)
+{
+    if (sparse_component_set_t* sparseSet = FindSparseSet(componentID))
+    {
+        return *sparseSet;
+    }
+
+    ecs::type_key componentType; 
+    ecs::component_data componentData;
+    if (!GetComponentsRegistry()->TryGetComponentData(componentID, componentType, componentData))
+    {
+        throw std::invalid_argument("Component not found in the database. Call RegisterComponent() first.");
+    }
+
+    if (componentID >= m_sparseSets.size())
+    {
+        m_sparseSets.resize(componentID + 1);
+    }
+
+    m_sparseSets[componentID] = std::make_unique<sparse_component_set_t>(componentData);
+    return *m_sparseSets[componentID];
+}
+
+const ecs::sparse_component_set_t* ecs::ArchetypesRegistry::FindSparseSetForQuery(const component_id componentID)
+{
+    if (GetComponentsRegistry()->GetComponentStorage(componentID) != EComponentStorage::SparseSet)
+    {
+        return nullptr;
+    }
+
+    // an empty set makes the query match nothing, as expected
+    return &GetOrCreateSparseSet(componentID);
+}
+
+void ecs::ArchetypesRegistry::RemoveSparseComponents(entity_id entity)
+{
+    for (const std::unique_ptr<sparse_component_set_t>& sparseSet : m_sparseSets)
+    {
+        if (sparseSet != nullptr)
+        {
+            sparseSet->remove_component(entity);
+        }
+    }
+}
+
+void ecs::ArchetypesRegistry::Reserve(archetype_id archetypeID, const size_t numEntities)
+{
+    if (archetypeID >= m_archetypeSets.size())
+    {
+        throw std::out_of_range("Archetype not found in the archetypes registry");
+    }
+
+    m_archetypeSets[archetypeID].reserve(numEntities);
+}
 
-    // associate the entity to that archetype hash.
-    m_entitiesArchetypeHashesMap[entity] = id;
+void ecs::ArchetypesRegistry::SetChunkGrowthPolicy(const chunk_growth_policy_t& growthPolicy)
+{
+    m_chunkGrowthPolicy = growthPolicy;
+    for (archetype_set& archetypeSet : m_archetypeSets)
+    {
+        archetypeSet.set_growth_policy(growthPolicy);
+    }
 }
 
 void ecs::ArchetypesRegistry::Reset()
 {
     m_archetypeSets.clear();
     m_archetypesIDMap.clear();
-    m_entitiesArchetypeHashesMap.clear();
+    m_entityLocations.clear();
     m_archetypeIDGenerator.Reset();
     m_componentToArchetypeSetMap.clear();
+    m_sparseSets.clear();
+    m_retiredArchetypeIDs.clear();
+    m_queryCaches.clear();
+    m_compactCursor = 0;
+}
+
+bool ecs::ArchetypesRegistry::Compact(const size_t budget)
+{
+    for (size_t numVisitedArchetypes = 0; numVisitedArchetypes < budget && m_compactCursor < m_archetypeSets.size(); 
+        ++numVisitedArchetypes)
+    {
+        const archetype_id archetypeID = m_compactCursor++;
+        archetype_set& archetypeSet = m_archetypeSets[archetypeID];
+        if (archetypeSet.is_retired())
+        {
+            continue;
+        }
+
+        if (archetypeSet.get_num_entities() == 0)
+        {
+            RetireArchetype(archetypeID);
+        }
+        else
+        {
+            archetypeSet.shrink_to_fit();
+        }
+    }
+
+    if (m_compactCursor < m_archetypeSets.size())
+    {
+        return false;
+    }
+
+    for (const std::unique_ptr<sparse_component_set_t>& sparseSet : m_sparseSets)
+    {
+        if (sparseSet != nullptr)
+        {
+            sparseSet->shrink_to_fit();
+        }
+    }
+
+    m_compactCursor = 0;
+    return true;
+}
+
+void ecs::ArchetypesRegistry::RetireArchetype(const archetype_id archetypeID)
+{
+    archetype_set& archetypeSet = m_archetypeSets[archetypeID];
+    assert(archetypeSet.get_num_entities() == 0 && "Only archetypes without entities can be retired.");
+
+    // edges always come in pairs, so the archetypes with an edge leading here are the targets of its own edges
+    for (const archetype_edge_t& edge : archetypeSet.get_add_edges())
+    {
+        m_archetypeSets[edge.targetArchetypeID].remove_edges_to(archetypeID);
+    }
+
+    for (const archetype_edge_t& edge : archetypeSet.get_remove_edges())
+    {
+        m_archetypeSets[edge.targetArchetypeID].remove_edges_to(archetypeID);
+    }
+
+    for (const component_id componentID : archetypeSet.get_archetype())
+    {
+        auto optionalArchetypes = m_componentToArchetypeSetMap.find(componentID);
+        optionalArchetypes->second.erase(archetypeID);
+        if (optionalArchetypes->second.empty())
+        {
+            m_componentToArchetypeSetMap.erase(optionalArchetypes);
+        }
+    }
+
+    for (const std::unique_ptr<query_cache_t>& queryCache : m_queryCaches)
+    {
+        if (queryCache != nullptr && queryCache->matches(archetypeSet.get_archetype()))
+        {
+            std::erase(queryCache->archetypes, archetypeID);
+        }
+    }
+
+    m_archetypesIDMap.erase(archetypeSet.get_archetype());
+    archetypeSet = archetype_set();
+    m_retiredArchetypeIDs.push_back(archetypeID);
+}
+
+const ecs::ArchetypesRegistry::entity_location_t& ecs::ArchetypesRegistry::GetEntityLocation(entity_id entity) const
+{
+    if (const entity_location_t* location = FindEntityLocation(entity))
+    {
+        return *location;
+    }
+
+    throw std::out_of_range("Entity not found in the archetypes registry");
+}
+
+void ecs::ArchetypesRegistry::SetEntityLocation(entity_id entity, archetype_id archetypeID, size_t row)
+{
+    const size_t index = entity_index(entity);
+    if (index >= m_entityLocations.size())
+    {
+        m_entityLocations.resize(std::max(index + 1, m_entityLocations.size() * 2));
+    }
+
+    entity_location_t& location = m_entityLocations[index];
+    location.archetypeID = archetypeID;
+    location.row = row;
+    location.generation = entity_generation(entity);
 }
 
 void* ecs::ArchetypesRegistry::GetComponent(entity_id entity, const component_id componentID)
 {
-    const archetype_id archetypeID = m_entitiesArchetypeHashesMap.at(entity);
-    const archetype_set& set = m_archetypeSets[archetypeID];
-    const size_t entityIndex = set.get_entity_index(entity);
-    return set.get_component_at_index(componentID, entityIndex);
+    const entity_location_t& location = GetEntityLocation(entity);
+    if (const sparse_component_set_t* sparseSet = FindSparseSet(componentID))
+    {
+        if (void* component = sparseSet->find_component(entity))
+        {
+            return component;
+        }
+
+        throw std::out_of_range("Component not found in the sparse set");
+    }
+
+    archetype_set& archetypeSet = m_archetypeSets[location.archetypeID];
+    void* component = archetypeSet.get_component_at_index(componentID, location.row);
+    archetypeSet.mark_changed(componentID, location.row, m_changeTick);
+    return component;
+}
+
+void ecs::ArchetypesRegistry::GetComponentFields(entity_id entity, const component_id componentID, 
+    std::span<void*> outFields)
+{
+    const entity_location_t& location = GetEntityLocation(entity);
+    archetype_set& archetypeSet = m_archetypeSets[location.archetypeID];
+    archetypeSet.mark_changed(componentID, location.row, m_changeTick);
+    const chunk_layout_t& layout = archetypeSet.get_layout();
+
+    // the columns of the fields follow the one of the first field
+    const chunk_column_t* fieldColumns = &archetypeSet.get_column(componentID);
+    const archetype_chunk_t& chunk = archetypeSet.get_chunk(location.row / layout.rows_per_chunk());
+    for (size_t fieldIndex = 0; fieldIndex < outFields.size(); ++fieldIndex)
+    {
+        outFields[fieldIndex] = chunk.get_component(fieldColumns[fieldIndex], location.row % layout.rows_per_chunk());
+    }
 }
 
 void* ecs::ArchetypesRegistry::FindComponent(entity_id entity, const component_id componentID)
 {
-    auto optionalArchetypeID = m_entitiesArchetypeHashesMap.find(entity);
-    if (optionalArchetypeID != m_entitiesArchetypeHashesMap.end())
+    if (const entity_location_t* location = FindEntityLocation(entity))
     {
-        const archetype_set& set = m_archetypeSets[optionalArchetypeID->second];
-        size_t entityIndex = -1;
-        if (set.try_get_entity_index(entity, entityIndex))
+        if (const sparse_component_set_t* sparseSet = FindSparseSet(componentID))
         {
-            return set.find_component_at_index(componentID, entityIndex);
+            return sparseSet->find_component(entity);
         }
+
+        archetype_set& archetypeSet = m_archetypeSets[location->archetypeID];
+        void* component = archetypeSet.find_component_at_index(componentID, location->row);
+        if (component != nullptr)
+        {
+            archetypeSet.mark_changed(componentID, location->row, m_changeTick);
+        }
+
+        return component;
     }
 
     return nullptr;
 }
 
+void ecs::ArchetypesRegistry::SetComponentEnabled(entity_id entity, const component_id componentID, const bool enabled)
+{
+    const entity_location_t& location = GetEntityLocation(entity);
+    if (FindSparseSet(componentID) != nullptr)
+    {
+        throw std::logic_error("Components stored in sparse sets are not enableable.");
+    }
+
+    m_archetypeSets[location.archetypeID].set_component_enabled(componentID, location.row, enabled);
+}
+
+bool ecs::ArchetypesRegistry::IsComponentEnabled(entity_id entity, const component_id componentID) const
+{
+    const entity_location_t& location = GetEntityLocation(entity);
+    if (const sparse_component_set_t* sparseSet = FindSparseSet(componentID))
+    {
+        if (!sparseSet->contains(entity))
+        {
+            throw std::out_of_range("Component not found in the sparse set");
+        }
+
+        return true;
+    }
+
+    return m_archetypeSets[location.archetypeID].is_component_enabled(componentID, location.row);
+}
+
 const ecs::archetype& ecs::ArchetypesRegistry::GetArchetype(entity_id entity) const
 {
-    const archetype_id archetypeID = m_entitiesArchetypeHashesMap.at(entity);
-    return m_archetypeSets[archetypeID].get_archetype();
+    return m_archetypeSets[GetEntityLocation(entity).archetypeID].get_archetype();
 }
 
 ecs::archetype_id ecs::ArchetypesRegistry::GetArchetypeID(entity_id entity) const
 {
-    return m_entitiesArchetypeHashesMap.at(entity);
+    return GetEntityLocation(entity).archetypeID;
 }
 
 void ecs::ArchetypesRegistry::AddComponent(entity_id entity, const type_key& componentType)
 {
-    const archetype& currentArchetype = GetArchetype(entity);
-    const component_id componentID = m_world->GetComponentsRegistry()->GetComponentID(componentType);
-    if (currentArchetype.has_component(componentID))
+    AddComponent(entity, GetComponentsRegistry()->GetComponentID(componentType));
+}
+
+void ecs::ArchetypesRegistry::AddComponent(entity_id entity, const component_id componentID)
+{
+    const archetype_id currentArchetypeID = GetEntityLocation(entity).archetypeID;
+    const archetype_set& currentSet = m_archetypeSets[currentArchetypeID];
+    if (const archetype_edge_t* edge = currentSet.find_add_edge(componentID))
     {
+        MoveEntity(entity, *edge);
         return;
     }
 
-    archetype newArchetype = currentArchetype; // @todo possibly unnecessary copy constructor here
-    newArchetype.add_component(componentID);
-
-    MoveEntity(entity, newArchetype);
-}
+    // sparse components never change the archetype of the entity
+    if (GetComponentsRegistry()->GetComponentStorage(componentID) == EComponentStorage::SparseSet)
+    {
+        GetOrCreateSparseSet(componentID).add_component(entity);
+        return;
+    }
 
-void ecs::ArchetypesRegistry::AddComponent(entity_id entity, const component_id componentID)
-{
     ecs::type_key componentType; 
     ecs::component_data componentData;
-    if (GetComponentsRegistry()->TryGetComponentData(componentID, componentType, componentData))
+    if (currentSet.get_archetype().has_component(componentID) 
+        || !GetComponentsRegistry()->TryGetComponentData(componentID, componentType, componentData))
     {
-        AddComponent(entity, componentType);
+        return;
     }
+
+    MoveEntity(entity, GetOrCreateArchetypeEdge(currentArchetypeID, componentID, true));
 }
 
 void ecs::ArchetypesRegistry::RemoveComponent(entity_id entity, const type_key& componentType)
 {
-    archetype_id archetypeID;
-    const archetype& currentArchetype = GetArchetype(entity);
-    const component_id componentID = GetComponentsRegistry()->GetComponentID(componentType);
-    if (!currentArchetype.has_component(componentID))
+    RemoveComponent(entity, GetComponentsRegistry()->GetComponentID(componentType));
+}
+
+void ecs::ArchetypesRegistry::RemoveComponent(entity_id entity, const component_id componentID)
+{
+    const archetype_id currentArchetypeID = GetEntityLocation(entity).archetypeID;
+    const archetype_set& currentSet = m_archetypeSets[currentArchetypeID];
+    if (const archetype_edge_t* edge = currentSet.find_remove_edge(componentID))
     {
+        MoveEntity(entity, *edge);
         return;
     }
 
-    archetype newArchetype = currentArchetype;
-    newArchetype.remove_component(componentID);
+    if (sparse_component_set_t* sparseSet = FindSparseSet(componentID))
+    {
+        sparseSet->remove_component(entity);
+        return;
+    }
+
+    if (!currentSet.get_archetype().has_component(componentID))
+    {
+        return;
+    }
 
-    MoveEntity(entity, newArchetype);
+    MoveEntity(entity, GetOrCreateArchetypeEdge(currentArchetypeID, componentID, false));
 }
 
-void ecs::ArchetypesRegistry::RemoveComponent(entity_id entity, const component_id componentID)
+const ecs::ArchetypesRegistry::archetype_edge_t& ecs::ArchetypesRegistry::GetOrCreateArchetypeEdge(
+    archetype_id sourceArchetypeID, const component_id componentID, bool isAddition)
 {
-    ecs::type_key componentType;
-    ecs::component_data componentData;
-    if (GetComponentsRegistry()->TryGetComponentData(componentID, componentType, componentData))
+    const archetype_edge_t* cachedEdge = isAddition ? m_archetypeSets[sourceArchetypeID].find_add_edge(componentID)
+        : m_archetypeSets[sourceArchetypeID].find_remove_edge(componentID);
+    if (cachedEdge != nullptr)
     {
-        RemoveComponent(entity, componentType);
+        return *cachedEdge;
     }
-}
 
-void ecs::ArchetypesRegistry::MoveEntity(entity_id entity, const archetype& targetArchetype)
-{
+    archetype targetArchetype = m_archetypeSets[sourceArchetypeID].get_archetype();
+    if (isAddition)
+    {
+        targetArchetype.add_component(componentID);
+    }
+    else
+    {
+        targetArchetype.remove_component(componentID);
+    }
+
+    // may add a new archetype set, so references to the sets can only be taken afterwards
     const archetype_id targetArchetypeID = GetOrCreateArchetypeID(targetArchetype);
+    archetype_set& sourceSet = m_archetypeSets[sourceArchetypeID];
+    archetype_set& targetSet = m_archetypeSets[targetArchetypeID];
 
-    const archetype_id currentArchetypeID = m_entitiesArchetypeHashesMap.at(entity);
-    archetype_set& currentSet = m_archetypeSets[currentArchetypeID];
+    // also cache the opposite transition, which is very likely to happen sooner or later
+    archetype_edge_t reverseEdge;
+    reverseEdge.componentID = componentID;
+    reverseEdge.targetArchetypeID = sourceArchetypeID;
+    reverseEdge.columnMapping = targetSet.make_column_mapping(sourceSet);
 
-    // allocate memory for storing components of the entity in the new archetype.
-    archetype_set& targetSet = m_archetypeSets[targetArchetypeID];
+    archetype_edge_t edge;
+    edge.componentID = componentID;
+    edge.targetArchetypeID = targetArchetypeID;
+    edge.columnMapping = sourceSet.make_column_mapping(targetSet);
+
+    if (isAddition)
+    {
+        if (targetSet.find_remove_edge(componentID) == nullptr)
+        {
+            targetSet.set_remove_edge(std::move(reverseEdge));
+        }
 
-    // remove copy all components to new set and remove entity from current one.
-    currentSet.copy_entity_to(entity, targetSet);
-    currentSet.remove_entity(entity);
+        return sourceSet.set_add_edge(std::move(edge));
+    }
+    
+    if (targetSet.find_add_edge(componentID) == nullptr)
+    {
+        targetSet.set_add_edge(std::move(reverseEdge));
+    }
 
-    // update entities to archetypes map
-    m_entitiesArchetypeHashesMap[entity] = targetArchetypeID;
+    return sourceSet.set_remove_edge(std::move(edge));
+}
+
+void ecs::ArchetypesRegistry::MoveEntity(entity_id entity, const archetype_edge_t& edge)
+{
+    const entity_location_t location = GetEntityLocation(entity);
+    archetype_set& currentSet = m_archetypeSets[location.archetypeID];
+    archetype_set& targetSet = m_archetypeSets[edge.targetArchetypeID];
+
+    // move all components to new set and remove entity from current one.
+    const size_t targetRow = currentSet.move_entity_to(location.row, targetSet, edge.columnMapping, 
+        m_changeTick);
+    const entity_id movedEntity = currentSet.remove_at(location.row, false);
+    if (movedEntity != INVALID_ENTITY_ID)
+    {
+        m_entityLocations[entity_index(movedEntity)].row = location.row;
+    }
+
+    // update entities location
+    SetEntityLocation(entity, edge.targetArchetypeID, targetRow);
 }
 
 void ecs::ArchetypesRegistry::RemoveEntity(entity_id entity)
 {
-    auto optionalArchetypeID = m_entitiesArchetypeHashesMap.find(entity);
-    if (optionalArchetypeID != m_entitiesArchetypeHashesMap.end())
+    if (const entity_location_t* location = FindEntityLocation(entity))
     {
-        archetype_set& archetypeSet = m_archetypeSets[optionalArchetypeID->second];
-        archetypeSet.remove_entity(entity);
+        archetype_set& archetypeSet = m_archetypeSets[location->archetypeID];
+        const size_t row = location->row;
+        const entity_id movedEntity = archetypeSet.remove_at(row);
+        if (movedEntity != INVALID_ENTITY_ID)
+        {
+            m_entityLocations[entity_index(movedEntity)].row = row;
+        }
 
-        m_entitiesArchetypeHashesMap.erase(entity);
+        m_entityLocations[entity_index(entity)] = entity_location_t();
+        RemoveSparseComponents(entity);
+    }
+}
+
+void ecs::ArchetypesRegistry::RemoveEntities(std::span<const entity_id> entities)
+{
+    // forget the location of each entity first, so that duplicated IDs are only removed once
+    std::vector<std::pair<archetype_id, size_t>> removedRows;
+    removedRows.reserve(entities.size());
+    for (const entity_id entity : entities)
+    {
+        if (const entity_location_t* location = FindEntityLocation(entity))
+        {
+            removedRows.emplace_back(location->archetypeID, location->row);
+            m_entityLocations[entity_index(entity)] = entity_location_t();
+            RemoveSparseComponents(entity);
+        }
+    }
+
+    std::sort(removedRows.begin(), removedRows.end());
+
+    std::vector<size_t> archetypeRows;
+    for (size_t first = 0; first < removedRows.size(); )
+    {
+        const archetype_id archetypeID = removedRows[first].first;
+        archetypeRows.clear();
+        for (; first < removedRows.size() && removedRows[first].first == archetypeID; ++first)
+        {
+            archetypeRows.push_back(removedRows[first].second);
+        }
+
+        archetype_set& archetypeSet = m_archetypeSets[archetypeID];
+        archetypeSet.remove_rows(archetypeRows);
+
+        // the holes have been filled with rows coming from the end of the archetype
+        for (const size_t row : archetypeRows)
+        {
+            if (row >= archetypeSet.get_num_entities())
+            {
+                break;
+            }
+
+            m_entityLocations[entity_index(archetypeSet.get_entity_at_index(row))].row = row;
+        }
     }
 }
 
@@ -271,9 +1144,21 @@ ecs::archetype_id ecs::ArchetypesRegistry::GetOrCreateArchetypeID(const archetyp
     auto optionalArchetypeID = m_archetypesIDMap.find(archetype);
     if (optionalArchetypeID == m_archetypesIDMap.end())
     {
-        const archetype_id id = m_archetypeIDGenerator.GenerateNewUniqueID();
+        // the slots of retired archetypes are reused first
+        archetype_id id;
+        if (!m_retiredArchetypeIDs.empty())
+        {
+            id = m_retiredArchetypeIDs.back();
+            m_retiredArchetypeIDs.pop_back();
+            m_archetypeSets[id] = archetype_set(archetype, GetComponentsRegistry(), m_chunkGrowthPolicy, m_chunkAllocator);
+        }
+        else
+        {
+            id = m_archetypeIDGenerator.GenerateNewUniqueID();
+            m_archetypeSets.emplace_back(archetype, GetComponentsRegistry(), m_chunkGrowthPolicy, m_chunkAllocator);
+        }
+
         m_archetypesIDMap[archetype] = id; 
-        m_archetypeSets.emplace_back(archetype, GetComponentsRegistry());
 
         // update the component to archetype map for consistent querying
         for (const component_id componentID : archetype)
@@ -281,6 +1166,15 @@ ecs::archetype_id ecs::ArchetypesRegistry::GetOrCreateArchetypeID(const archetyp
             m_componentToArchetypeSetMap[componentID].insert(id);
         }
 
+        // queries never look for archetypes again: they are told about the new ones instead
+        for (const std::unique_ptr<query_cache_t>& queryCache : m_queryCaches)
+        {
+            if (queryCache != nullptr && queryCache->matches(archetype))
+            {
+                queryCache->archetypes.push_back(id);
+            }
+        }
+
         return id;
     }
     else
@@ -297,24 +1191,67 @@ ecs::ArchetypesRegistry::archetype_set& ecs::ArchetypesRegistry::GetOrCreateArch
 
 void ecs::ArchetypesRegistry::QueryEntities(std::initializer_list<component_id> components, std::vector<entity_id>& entities)
 {
+    std::vector<const sparse_component_set_t*> sparseSets;
+    archetype::Signature archetypeComponents;
+    for (const component_id componentID : components)
+    {
+        if (const sparse_component_set_t* sparseSet = FindSparseSetForQuery(componentID))
+        {
+            sparseSets.push_back(sparseSet);
+        }
+        else
+        {
+            archetypeComponents.insert(componentID);
+        }
+    }
+
     ArchetypesSet matchingArchetypes;
-    QueryArchetypes(components, matchingArchetypes);
+    QueryArchetypes(archetypeComponents, matchingArchetypes);
     
     // get all the entities from the matching archetypes 
     entities.clear();
     for (const archetype_id archetypeID : matchingArchetypes)
     {
         const archetype_set& archetypeSet = m_archetypeSets[archetypeID];
-        entities.reserve(entities.capacity() + archetypeSet.get_num_entities());
+        entities.reserve(entities.size() + archetypeSet.get_num_entities());
+
+        // entities having any of the components disabled are left out
+        std::vector<const chunk_column_t*> enableableColumns;
+        for (const component_id componentID : archetypeComponents)
+        {
+            const chunk_column_t& column = archetypeSet.get_column(componentID);
+            if (column.is_enableable())
+            {
+                enableableColumns.push_back(&column);
+            }
+        }
         
-        for (const std::pair<entity_id, size_t>& entityPair : archetypeSet.entity_map())
+        for (size_t chunkIndex = 0; chunkIndex < archetypeSet.get_num_chunks(); ++chunkIndex)
         {
-            entities.push_back(entityPair.first);
+            const archetype_chunk_t& chunk = archetypeSet.get_chunk(chunkIndex);
+            const size_t numEntitiesInChunk = archetypeSet.get_num_entities_in_chunk(chunkIndex);
+            if (enableableColumns.empty())
+            {
+                entities.insert(entities.end(), chunk.entities(), chunk.entities() + numEntitiesInChunk);
+                continue;
+            }
+
+            for_each_enabled_row(chunk, numEntitiesInChunk, enableableColumns, 
+                [&entities, &chunk](const size_t row) { entities.push_back(chunk.entities()[row]); });
         }
     }
+
+    if (!sparseSets.empty())
+    {
+        std::erase_if(entities, [&sparseSets](const entity_id entity)
+        {
+            return std::any_of(sparseSets.begin(), sparseSets.end(), 
+                [entity](const sparse_component_set_t* sparseSet) { return !sparseSet->contains(entity); });
+        });
+    }
 }
 
-void ecs::ArchetypesRegistry::QueryArchetypes(std::initializer_list<component_id> components, 
+void ecs::ArchetypesRegistry::QueryArchetypes(const archetype::Signature& components, 
     ArchetypesSet& matchingArchetypes)
 {
     matchingArchetypes.clear();
@@ -323,33 +1260,60 @@ void ecs::ArchetypesRegistry::QueryArchetypes(std::initializer_list<component_id
     {
         for (size_t i = 0; i < m_archetypeSets.size(); ++i)
         {
-            matchingArchetypes.insert(i);
+            if (!m_archetypeSets[i].is_retired())
+            {
+                matchingArchetypes.insert(matchingArchetypes.end(), i);
+            }
         }
     }
     else
     {
-        auto componentIt = components.begin();
-        matchingArchetypes = m_componentToArchetypeSetMap[*componentIt];
-
-        // reduce the starting set by intersecting with all the other component's sets 
+        // the archetypes containing the rarest component are the only candidates
+        const ArchetypesSet* candidates = nullptr;
+        for (const component_id componentID : components)
         {
-            ArchetypesSet temp;
+            auto optionalArchetypes = m_componentToArchetypeSetMap.find(componentID);
+            if (optionalArchetypes == m_componentToArchetypeSetMap.end())
+            {
+                return;
+            }
+
+            if (candidates == nullptr || optionalArchetypes->second.size() < candidates->size())
+            {
+                candidates = &optionalArchetypes->second;
+            }
+        }
 
-            for (++componentIt; componentIt != components.end(); ++componentIt)
+        for (const archetype_id archetypeID : *candidates)
+        {
+            if (m_archetypeSets[archetypeID].get_archetype().matches(components))
             {
-                temp.clear();
-                const ArchetypesSet& currentSet = m_componentToArchetypeSetMap[*componentIt];
-                std::set_intersection(matchingArchetypes.begin(), 
-                    matchingArchetypes.end(),
-                    currentSet.begin(), 
-                    currentSet.end(), 
-                    std::inserter(temp, temp.begin()));
-                matchingArchetypes = std::move(temp);
+                matchingArchetypes.insert(matchingArchetypes.end(), archetypeID);
             }
         }
     }
 }
 
+std::unique_ptr<ecs::ArchetypesRegistry::query_cache_t> ecs::ArchetypesRegistry::CreateQueryCache(
+    const archetype::Signature& components, const archetype::Signature& excludedComponents)
+{
+    std::unique_ptr<query_cache_t> queryCache = std::make_unique<query_cache_t>();
+    queryCache->components = components;
+    queryCache->excludedComponents = excludedComponents;
+
+    ArchetypesSet matchingArchetypes;
+    QueryArchetypes(components, matchingArchetypes);
+    for (const archetype_id archetypeID : matchingArchetypes)
+    {
+        if (!m_archetypeSets[archetypeID].get_archetype().get_signature().intersects(excludedComponents))
+        {
+            queryCache->archetypes.push_back(archetypeID);
+        }
+    }
+
+    return queryCache;
+}
+
 ecs::ComponentsRegistry* ecs::ArchetypesRegistry::GetComponentsRegistry() const
 {
     return m_world->GetComponentsRegistry().get();
@@ -1,22 +1,42 @@
 #include "Core/ComponentsRegistry.h"
 
 ecs::component_id ecs::ComponentsRegistry::AddComponentData(const ecs::type_key& componentType, 
-	const size_t dataSize, const size_t initialCapacity)
+	const size_t dataSize, const size_t alignment, const component_ops_t& ops, const size_t initialCapacity,
+	const EComponentStorage storage, const bool enableable, std::span<const component_field_t> fields)
 {
+	if (enableable && storage == EComponentStorage::SparseSet)
+	{
+		throw std::invalid_argument("Components stored in sparse sets can't be enableable: just remove them.");
+	}
+
+	if (!fields.empty() && storage == EComponentStorage::SparseSet)
+	{
+		throw std::invalid_argument("SoA components can only be stored in archetypes.");
+	}
+
 	auto optionalComponentData = m_componentsClassMap.find(componentType);
 	if (optionalComponentData == m_componentsClassMap.end())
 	{
 		const component_id newID = m_componentIDGenerator.GenerateNewUniqueID();
-		m_componentsClassMap.emplace(componentType, component_data(dataSize, newID, initialCapacity));
+		m_componentsClassMap.emplace(componentType, component_data(dataSize, newID, initialCapacity, alignment, ops, storage, enableable, fields));
 		if (newID >= m_componentTypes.size())
 		{
 			m_componentTypes.resize(newID + 8);
+			m_componentStorages.resize(newID + 8, EComponentStorage::Archetype);
 		}
 		m_componentTypes[newID] = componentType;
+		m_componentStorages[newID] = storage;
 		return newID;
 	}
 	else
 	{
+		// entities may already store the component, so it can't be moved elsewhere
+		if (optionalComponentData->second.storage() != storage 
+			|| optionalComponentData->second.is_enableable() != enableable)
+		{
+			throw std::logic_error("Component already registered with different settings.");
+		}
+
 		return optionalComponentData->second.serial();
 	}
 }
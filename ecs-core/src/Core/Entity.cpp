@@ -13,10 +13,28 @@ EntityHandle::EntityHandle()
 
 EntityHandle::EntityHandle(std::weak_ptr<World> world, entity_id id, archetype_id archetypeID, 
     std::shared_ptr<BatchComponentActionProcessor> batchComponentActionProcessor)
-    : m_world(world), m_id(id), m_archetypeID(archetypeID), m_batchComponentActionProcessor(batchComponentActionProcessor)
+    : m_world(world), m_id(id), m_archetypeID(archetypeID), 
+    m_batchComponentActionProcessor(batchComponentActionProcessor.get()), 
+    m_batchComponentActionProcessorOwner(batchComponentActionProcessor)
+{}
+
+EntityHandle::EntityHandle(World* world, entity_id id, archetype_id archetypeID, 
+    BatchComponentActionProcessor* batchComponentActionProcessor)
+    : m_id(id), m_archetypeID(archetypeID), m_borrowedWorld(world), 
+    m_batchComponentActionProcessor(batchComponentActionProcessor)
 {}
 
 
+bool EntityHandle::IsValid() const
+{
+    if (World* world = GetWorld())
+    {
+        return world->IsEntityAlive(m_id);
+    }
+
+    return false;
+}
+
 void EntityHandle::AddComponent(component_id componentID)
 {
     if (ArchetypesRegistry* archetypesRegistry = GetArchetypesRegistry())
@@ -44,6 +62,17 @@ void* EntityHandle::GetComponent(component_id componentID) const
     throw std::out_of_range("Component not found");
 }
 
+void EntityHandle::GetComponentFields(component_id componentID, std::span<void*> outFields) const
+{
+    if (ArchetypesRegistry* archetypesRegistry = GetArchetypesRegistry())
+    {
+        archetypesRegistry->GetComponentFields(m_id, componentID, outFields);
+        return;
+    }
+
+    throw std::out_of_range("Component not found");
+}
+
 void * EntityHandle::FindComponent(component_id componentID) const noexcept
 {
     if (ArchetypesRegistry* archetypesRegistry = GetArchetypesRegistry())
@@ -70,11 +99,39 @@ void EntityHandle::DeferredRemoveComponent(component_id componentID)
     }
 }
 
+void EntityHandle::SetComponentEnabled(component_id componentID, const bool enabled)
+{
+    if (ArchetypesRegistry* archetypesRegistry = GetArchetypesRegistry())
+    {
+        archetypesRegistry->SetComponentEnabled(m_id, componentID, enabled);
+    }
+}
+
+bool EntityHandle::IsComponentEnabled(component_id componentID) const
+{
+    if (ArchetypesRegistry* archetypesRegistry = GetArchetypesRegistry())
+    {
+        return archetypesRegistry->IsComponentEnabled(m_id, componentID);
+    }
+
+    throw std::out_of_range("Component not found");
+}
+
+std::weak_ptr<World> EntityHandle::world() const
+{
+    return m_borrowedWorld != nullptr ? m_borrowedWorld->weak_from_this() : m_world;
+}
+
+World* EntityHandle::GetWorld() const
+{
+    return m_borrowedWorld != nullptr ? m_borrowedWorld : m_world.lock().get();
+}
+
 ArchetypesRegistry* EntityHandle::GetArchetypesRegistry() const
 {
-    if (!m_world.expired())
+    if (World* world = GetWorld())
     {
-        return m_world.lock()->GetArchetypesRegistry().get();
+        return world->GetArchetypesRegistry().get();
     }
 
     return nullptr;
@@ -82,9 +139,9 @@ ArchetypesRegistry* EntityHandle::GetArchetypesRegistry() const
 
 ComponentsRegistry* EntityHandle::GetComponentsRegistry() const
 {
-    if (!m_world.expired())
+    if (World* world = GetWorld())
     {
-        return m_world.lock()->GetComponentsRegistry().get();
+        return world->GetComponentsRegistry().get();
     }
 
     return nullptr;
@@ -1,64 +1,84 @@
 #include "Core/PackedComponentArray.h"
+#include <cassert>
+#include <cstdint>
 
-ecs::packed_component_array_t::packed_component_array_t() : m_data(nullptr, [](void*){}),
-    m_size{0}, m_serial{0}, m_instanceSize{0}, m_capacity{0}
+ecs::packed_component_array_t::packed_component_array_t() : m_data(nullptr, aligned_deleter{alignof(std::max_align_t)}),
+    m_size{0}, m_serial{0}, m_instanceSize{0}, m_alignment{alignof(std::max_align_t)}, m_ops{}, m_capacity{0}
 {
 
 }
 
-ecs::packed_component_array_t::packed_component_array_t(const component_data& componentData) : m_data(nullptr, [](void*){})
+ecs::packed_component_array_t::packed_component_array_t(const component_data& componentData) : m_data(nullptr, aligned_deleter{alignof(std::max_align_t)})
 {
     m_serial = componentData.serial();
     m_size = 0;
     m_instanceSize = componentData.data_size();
+    m_alignment = componentData.alignment();
+    m_ops = componentData.ops();
     m_capacity = componentData.initial_capacity();
 
     // allocate data
-    void* memory = ::operator new[](m_instanceSize * m_capacity);
-    
-    // Custom deleter that properly destroys all elements and deallocates memory
-    auto deleter = [](void* ptr) 
-    {
-        ::operator delete[](ptr);
-    };
-    
-    m_data = std::unique_ptr<void, void(*)(void*)>(memory, deleter);
+    m_data = allocate(m_capacity);
 }
 
 ecs::packed_component_array_t::packed_component_array_t(const ecs::packed_component_array_t& other)
-    : m_data(nullptr, [](void*){})
+    : m_data(nullptr, aligned_deleter{alignof(std::max_align_t)})
 {
     m_serial = other.component_serial();
     m_size = other.size();
     m_instanceSize = other.component_size();
+    m_alignment = other.alignment();
+    m_ops = other.m_ops;
     m_capacity = other.capacity();
-    std::memcpy(other.m_data.get(), m_data.get(), m_instanceSize * m_capacity);
+    m_data = allocate(m_capacity);
+    copy_components(m_ops, m_instanceSize, m_data.get(), other.m_data.get(), m_size);
 }
 
 ecs::packed_component_array_t::packed_component_array_t(ecs::packed_component_array_t&& other) noexcept
-: m_data(nullptr, [](void*){})
+: m_data(nullptr, aligned_deleter{alignof(std::max_align_t)}), m_size{0}, m_serial{0}, m_instanceSize{0}, m_alignment{alignof(std::max_align_t)}, m_ops{}, m_capacity{0}
 {
     std::swap(m_data, other.m_data);
     std::swap(m_size, other.m_size);
     std::swap(m_serial, other.m_serial);
     std::swap(m_instanceSize, other.m_instanceSize);
+    std::swap(m_alignment, other.m_alignment);
+    std::swap(m_ops, other.m_ops);
     std::swap(m_capacity, other.m_capacity);
 }
 
 ecs::packed_component_array_t::~packed_component_array_t()
 {
-    m_data.release();
+    destroy_components(m_ops, m_data.get(), m_size);
+}
+
+ecs::packed_component_array_t::aligned_data_ptr ecs::packed_component_array_t::allocate(const size_t capacity) const
+{
+    if (capacity == 0 || m_instanceSize == 0)
+    {
+        return aligned_data_ptr(nullptr, aligned_deleter{m_alignment});
+    }
+
+    void* memory = ::operator new[](m_instanceSize * capacity, std::align_val_t(m_alignment));
+    assert(reinterpret_cast<uintptr_t>(memory) % m_alignment == 0 && "Misaligned component array.");
+    return aligned_data_ptr(memory, aligned_deleter{m_alignment});
 }
 
 void* ecs::packed_component_array_t::add_component()
+{
+    void* address = add_uninitialized_component();
+    construct_components(m_ops, address, 1);
+    return address;
+}
+
+void* ecs::packed_component_array_t::add_uninitialized_component()
 {
     if (m_size == m_capacity)
     {
-        // reallocate memory
-        m_capacity *= 2;
-        void* newMemory = ::operator new[](m_instanceSize * m_capacity);
-        std::memcpy(m_data.get(), newMemory, m_instanceSize * m_size);
-        m_data.reset(newMemory);
+        // reallocate memory, moving all the components at once
+        m_capacity = m_capacity > 0 ? m_capacity * 2 : 1;
+        aligned_data_ptr newMemory = allocate(m_capacity);
+        move_components(m_ops, m_instanceSize, newMemory.get(), m_data.get(), m_size);
+        m_data = std::move(newMemory);
     }
 
     // address of the next free slot of the array
@@ -84,13 +104,31 @@ void ecs::packed_component_array_t::delete_at(const size_t index)
         throw std::out_of_range("Index out of bounds");
     }
 
-    // move the last element to the deleted element 
+    // move the last element to the deleted element
     void* last = get_component(m_size - 1);
     void* toDelete = get_component(index);
-    std::memcpy(last, toDelete, m_instanceSize);
+    destroy_components(m_ops, toDelete, 1);
+    if (last != toDelete)
+    {
+        move_components(m_ops, m_instanceSize, toDelete, last, 1);
+    }
     m_size -= 1;
 }
 
+bool ecs::packed_component_array_t::shrink_to_fit()
+{
+    if (m_capacity == m_size)
+    {
+        return false;
+    }
+
+    aligned_data_ptr newMemory = allocate(m_size);
+    move_components(m_ops, m_instanceSize, newMemory.get(), m_data.get(), m_size);
+    m_data = std::move(newMemory);
+    m_capacity = m_size;
+    return true;
+}
+
 void ecs::packed_component_array_t::copy_to(size_t index, ecs::packed_component_array_t& destination, size_t destinationIndex)
 {
     if (index >= m_size)
@@ -108,5 +146,6 @@ void ecs::packed_component_array_t::copy_to(size_t index, ecs::packed_component_
 
     // perform copy
     void* destinationPtr = destination.get_component(destinationIndex);
-    std::memcpy(destinationPtr, source, m_instanceSize);
+    destroy_components(destination.m_ops, destinationPtr, 1);
+    copy_components(m_ops, m_instanceSize, destinationPtr, source, 1);
 }
@@ -0,0 +1,95 @@
+#include "Core/SparseComponentSet.h"
+#include <algorithm>
+
+ecs::sparse_component_set_t::sparse_component_set_t(const component_data& componentData)
+    : m_components(componentData)
+{
+
+}
+
+void* ecs::sparse_component_set_t::add_component(const entity_id entity)
+{
+    if (void* existingComponent = find_component(entity))
+    {
+        return existingComponent;
+    }
+
+    const size_t index = entity_index(entity);
+    if (index >= m_sparse.size())
+    {
+        m_sparse.resize(std::max(index + 1, m_sparse.size() * 2), INVALID_INDEX);
+    }
+
+    m_sparse[index] = static_cast<uint32_t>(m_entities.size());
+    m_entities.push_back(entity);
+    if (!is_tag())
+    {
+        m_components.add_component();
+    }
+
+    return find_component(entity);
+}
+
+bool ecs::sparse_component_set_t::remove_component(const entity_id entity)
+{
+    const uint32_t denseIndex = find_dense_index(entity);
+    if (denseIndex == INVALID_INDEX)
+    {
+        return false;
+    }
+
+    // the last component takes the place of the removed one, like in packed_component_array_t
+    const entity_id lastEntity = m_entities.back();
+    m_entities[denseIndex] = lastEntity;
+    m_sparse[entity_index(lastEntity)] = denseIndex;
+    m_entities.pop_back();
+    if (!is_tag())
+    {
+        m_components.delete_at(denseIndex);
+    }
+
+    m_sparse[entity_index(entity)] = INVALID_INDEX;
+    return true;
+}
+
+void* ecs::sparse_component_set_t::find_component(const entity_id entity) const
+{
+    const uint32_t denseIndex = find_dense_index(entity);
+    if (denseIndex == INVALID_INDEX)
+    {
+        return nullptr;
+    }
+
+    if (is_tag())
+    {
+        return const_cast<entity_id*>(&m_entities[denseIndex]);
+    }
+
+    return m_components.get_component(denseIndex);
+}
+
+void ecs::sparse_component_set_t::shrink_to_fit()
+{
+    // the sparse array only needs to reach the highest entity index in the set
+    size_t sparseSize = 0;
+    for (const entity_id entity : m_entities)
+    {
+        sparseSize = std::max(sparseSize, entity_index(entity) + 1);
+    }
+
+    m_sparse.resize(sparseSize);
+    m_sparse.shrink_to_fit();
+    m_entities.shrink_to_fit();
+    m_components.shrink_to_fit();
+}
+
+void ecs::sparse_component_set_t::clear()
+{
+    while (m_components.size() > 0)
+    {
+        m_components.delete_at(m_components.size() - 1);
+    }
+
+    m_entities.clear();
+    m_sparse.clear();
+}
@@ -0,0 +1,136 @@
+#include "Core/ThreadPool.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    /* The pool whose task the current thread is running, if any. */
+    thread_local const ecs::ThreadPool* t_runningPool = nullptr;
+
+    struct running_pool_scope
+    {
+        explicit running_pool_scope(const ecs::ThreadPool* pool) : previousPool(t_runningPool) { t_runningPool = pool; }
+        ~running_pool_scope() { t_runningPool = previousPool; }
+
+        const ecs::ThreadPool* previousPool;
+    };
+}
+
+ecs::ThreadPool::ThreadPool(size_t numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    m_workers.reserve(numThreads - 1);
+    for (size_t threadIndex = 1; threadIndex < numThreads; ++threadIndex)
+    {
+        m_workers.emplace_back(&ThreadPool::RunWorker, this, threadIndex);
+    }
+}
+
+ecs::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ecs::ThreadPool::ParallelFor(const size_t numTasks, const std::function<void(size_t, size_t)>& task)
+{
+    // the calling thread would wait for itself, or for workers waiting for it
+    if (t_runningPool == this)
+    {
+        throw std::logic_error("ThreadPool::ParallelFor() can't be called from the tasks of the same pool");
+    }
+
+    // a single task is not worth waking the workers up
+    if (numTasks == 1 || m_workers.empty())
+    {
+        const running_pool_scope runningPoolScope(this);
+        for (size_t taskIndex = 0; taskIndex < numTasks; ++taskIndex)
+        {
+            task(taskIndex, 0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> dispatchLock(m_dispatchMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_numTasks = numTasks;
+        m_nextTask.store(0);
+        m_exception = nullptr;
+        m_numBusyWorkers = m_workers.size();
+        ++m_generation;
+    }
+
+    m_workAvailable.notify_all();
+    RunTasks(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_workDone.wait(lock, [this]() { return m_numBusyWorkers == 0; });
+    m_task = nullptr;
+
+    if (m_exception != nullptr)
+    {
+        std::rethrow_exception(m_exception);
+    }
+}
+
+void ecs::ThreadPool::RunWorker(const size_t threadIndex)
+{
+    size_t lastGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [&]() { return m_stopping || m_generation != lastGeneration; });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            lastGeneration = m_generation;
+        }
+
+        RunTasks(threadIndex);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_numBusyWorkers == 0)
+        {
+            m_workDone.notify_one();
+        }
+    }
+}
+
+void ecs::ThreadPool::RunTasks(const size_t threadIndex)
+{
+    const running_pool_scope runningPoolScope(this);
+    for (size_t taskIndex = m_nextTask.fetch_add(1); taskIndex < m_numTasks; taskIndex = m_nextTask.fetch_add(1))
+    {
+        try
+        {
+            (*m_task)(taskIndex, threadIndex);
+        }
+        catch (...)
+        {
+            // skip the remaining tasks, and let the caller know about the first failure only
+            m_nextTask.store(m_numTasks);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_exception == nullptr)
+            {
+                m_exception = std::current_exception();
+            }
+        }
+    }
+}
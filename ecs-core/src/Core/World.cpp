@@ -22,6 +22,74 @@ ecs::entity_id ecs::World::CreateEntity()
 	return id;
 }
 
+void ecs::World::GenerateEntityIDs(const size_t count, std::span<entity_id> outEntities)
+{
+	if (outEntities.size() < count)
+	{
+		throw std::invalid_argument("The output span is too small for the requested amount of entities");
+	}
+
+	m_entityIDGenerator.GenerateNewUniqueIDs(outEntities.first(count));
+}
+
+bool ecs::World::DestroyEntity(entity_id id)
+{
+	if (!m_entityIDGenerator.ReleaseID(id))
+	{
+		return false;
+	}
+
+	m_archetypesRegistry->RemoveEntity(id);
+	return true;
+}
+
+size_t ecs::World::DestroyEntities(std::span<const entity_id> ids)
+{
+	std::vector<entity_id> destroyedEntities;
+	destroyedEntities.reserve(ids.size());
+	for (const entity_id id : ids)
+	{
+		if (m_entityIDGenerator.ReleaseID(id))
+		{
+			destroyedEntities.push_back(id);
+		}
+	}
+
+	m_archetypesRegistry->RemoveEntities(destroyedEntities);
+	return destroyedEntities.size();
+}
+
+void ecs::World::SetChunkGrowthPolicy(const chunk_growth_policy_t& growthPolicy)
+{
+	m_archetypesRegistry->SetChunkGrowthPolicy(growthPolicy);
+}
+
+void ecs::World::SetChunkAllocator(const EChunkAllocator chunkAllocator)
+{
+	m_archetypesRegistry->SetChunkAllocator(chunkAllocator);
+}
+
+void ecs::World::SetNumThreads(const size_t numThreads)
+{
+	m_numThreads = numThreads;
+	m_threadPool.reset();
+}
+
+ecs::ThreadPool& ecs::World::GetThreadPool()
+{
+	if (m_threadPool == nullptr)
+	{
+		m_threadPool = std::make_unique<ThreadPool>(m_numThreads);
+	}
+
+	return *m_threadPool;
+}
+
+bool ecs::World::Compact(const size_t budget)
+{
+	return m_archetypesRegistry->Compact(budget);
+}
+
 ecs::EntityHandle ecs::World::GetEntity(entity_id id)
 {
 	std::weak_ptr<World> weakPtrToThis = shared_from_this();
@@ -44,6 +112,13 @@ void ecs::World::Update(ecs::real_t deltaTime)
 	std::shared_ptr<World> sharedSelf = shared_from_this(); 
 	for (auto systemPair : m_registeredSystems)
 	{
-		systemPair.second->Update(sharedSelf, deltaTime);
+		// the queries of the system only see the changes made since its previous run
+		ISystem& system = *systemPair.second;
+		m_archetypesRegistry->SetLastRunTick(system.m_lastRunTick);
+		system.Update(sharedSelf, deltaTime);
+		system.m_lastRunTick = m_archetypesRegistry->AdvanceChangeTick();
 	}
+
+	// outside of systems, every change is new
+	m_archetypesRegistry->SetLastRunTick(0);
 }
@@ -4,6 +4,11 @@
 #include <filesystem>
 #include <cmath>
 #include <algorithm>
+#include <vector>
+#include <span>
+#include <charconv>
+#include <string_view>
+#include <system_error>
 
 #include "Core/World.h"
 #include "Core/ArchetypeQuery.h"
@@ -41,36 +46,28 @@ namespace systems
     {
         void Update(std::weak_ptr<ecs::World> world, ecs::real_t deltaTime) override
         {
-            ecs::query<comps::Rect, comps::Velocity>::MakeQuery(world).forEach(
-                [deltaTime](ecs::EntityHandle entity, comps::Rect& rect, comps::Velocity& velocity)
+            ecs::query<comps::Rect, comps::Velocity>::MakeQuery(world).forEachChunk(
+                [deltaTime](std::span<const ecs::entity_id> entities, std::span<comps::Rect> rects, 
+                    std::span<comps::Velocity> velocities)
                 {
-                    rect.rect.x += static_cast<int>(velocity.x * deltaTime);
-                    rect.rect.y += static_cast<int>(velocity.y * deltaTime);
-
-                    // Simple bouncing off the edges of the screen
-                    if (rect.rect.x < 0 || rect.rect.x > 1024)
+                    for (size_t i = 0; i < entities.size(); ++i)
                     {
-                        velocity.x *= -1.0f;
-                        if (rect.rect.x < 0)
-                        {
-                            rect.rect.x = 3;
-                        }
-                        else
-                        {
-                            rect.rect.x = 1021;
-                        }
-                    }
+                        SDL_Rect& rect = rects[i].rect;
+                        comps::Velocity& velocity = velocities[i];
+                        rect.x += static_cast<int>(velocity.x * deltaTime);
+                        rect.y += static_cast<int>(velocity.y * deltaTime);
 
-                    if (rect.rect.y < 0 || rect.rect.y > 720)
-                    {
-                        velocity.y *= -1.0f;
-                        if (rect.rect.y < 0)
+                        // Simple bouncing off the edges of the screen
+                        if (rect.x < 0 || rect.x > 1024)
                         {
-                            rect.rect.y = 3;
+                            velocity.x *= -1.0f;
+                            rect.x = rect.x < 0 ? 3 : 1021;
                         }
-                        else
+
+                        if (rect.y < 0 || rect.y > 720)
                         {
-                            rect.rect.y = 717;
+                            velocity.y *= -1.0f;
+                            rect.y = rect.y < 0 ? 3 : 717;
                         }
                     }
                 });
@@ -86,7 +83,7 @@ namespace systems
         void Update(std::weak_ptr<ecs::World> world, ecs::real_t deltaTime) override
         {
             ecs::query<comps::Rect, comps::Color>::MakeQuery(world).forEach(
-                [&](ecs::EntityHandle entity, comps::Rect& rect, comps::Color& color)
+                [&](const comps::Rect& rect, const comps::Color& color)
                 {
                     SDL_SetRenderDrawColor(m_renderer, color.color.r, color.color.g, color.color.b, color.color.a);
                     SDL_RenderFillRect(m_renderer, &rect.rect);
@@ -100,17 +97,59 @@ namespace systems
     };
 }
 
+void PrintUsage(const char* executableName)
+{
+    std::cerr << "Usage: " << executableName << " [--huge-pages] [--entities N]" << std::endl
+        << "  --huge-pages  Allocate the storage of the entities from huge pages." << std::endl
+        << "  --entities N  Simulate N entities, with N greater than 0." << std::endl;
+}
 
-int main()
+int main(int argc, char* argv[])
 {
     using namespace std::chrono_literals;
 
+    // --huge-pages: allocate the storage of the entities from huge pages, to compare with the default heap
+    // --entities N: the number of entities to simulate
+    bool useHugePages = false;
+    size_t numEntities = 20000;
+    for (int argIndex = 1; argIndex < argc; ++argIndex)
+    {
+        const std::string arg = argv[argIndex];
+        if (arg == "--huge-pages")
+        {
+            useHugePages = true;
+        }
+        else if (arg == "--entities")
+        {
+            if (argIndex + 1 == argc)
+            {
+                std::cerr << "Missing value for --entities." << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+
+            const std::string_view value = argv[++argIndex];
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), numEntities);
+            if (error != std::errc() || end != value.data() + value.size() || numEntities == 0)
+            {
+                std::cerr << "Invalid number of entities: " << value << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
     ecs::Logger* logger = new ecs::Logger();
     logger->Run();
 
     ECS_LOG(Log, "Initializing ECS instance...");
     std::shared_ptr<ecs::World> world = std::make_shared<ecs::World>();
     world->Initialize();
+    if (useHugePages)
+    {
+        ECS_LOG(Log, "Allocating entities from huge pages.");
+        world->SetChunkAllocator(ecs::EChunkAllocator::HugePages);
+    }
 
     // Initialize SDL
     ECS_LOG(Log, "Initializing SDL instance...");
@@ -165,7 +204,6 @@ int main()
     SDL_Color color(0, 128, 135, 255);
     ecs::real_t maxVelocity = 500.0f;
     ecs::real_t minVelocity = 100.0f;
-    size_t numEntities = 20000;
     srand(static_cast<unsigned> (time(0)));
     const auto generateRandomVelocity = [minVelocity, maxVelocity]()
     {
@@ -182,18 +220,17 @@ int main()
 
     // Create entities with random positions, velocities, and colors
     auto startTime = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < numEntities; ++i)
-    {
-        const ecs::entity_id entity = world->CreateEntity<comps::Velocity, comps::Rect, comps::Color>();
-        ecs::EntityHandle handle = world->GetEntity(entity);
-        rect.x = 512;
-        rect.y = 360;
-        handle.GetComponent<comps::Rect>().rect = rect;
-        handle.GetComponent<comps::Color>().color = color;
-        comps::Velocity& velocity = handle.GetComponent<comps::Velocity>();
-        velocity.x = generateRandomVelocity();
-        velocity.y = generateRandomVelocity();   
-    }
+    std::vector<ecs::entity_id> entities(numEntities);
+    rect.x = 512;
+    rect.y = 360;
+    world->CreateEntities<comps::Velocity, comps::Rect, comps::Color>(numEntities, entities,
+        [&](size_t /*index*/, comps::Velocity& velocity, comps::Rect& entityRect, comps::Color& entityColor)
+        {
+            entityRect.rect = rect;
+            entityColor.color = color;
+            velocity.x = generateRandomVelocity();
+            velocity.y = generateRandomVelocity();
+        });
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
     ECS_LOG(Log, "Created {} entities in {} milliseconds.", numEntities, duration.count());
@@ -238,6 +275,11 @@ int main()
 
     static constexpr Uint64 targetFrameTime = static_cast<Uint64>((1.0 / 60.0) * 1000);
 
+    // the time spent updating the world, averaged every few frames
+    static constexpr size_t updateTimeSamples = 300;
+    std::chrono::microseconds totalUpdateTime(0);
+    size_t numUpdates = 0;
+
     while (s_keepUpdating)
     {
         currentTime = SDL_GetTicks64();
@@ -268,7 +310,16 @@ int main()
         SDL_RenderCopy(renderer, textTexture, NULL, &textLocation);
 
         // Update world
+        const auto updateStartTime = std::chrono::high_resolution_clock::now();
         world->Update(deltaTime);
+        totalUpdateTime += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - updateStartTime);
+        if (++numUpdates == updateTimeSamples)
+        {
+            ECS_LOG(Log, "Average update time: {} microseconds.", totalUpdateTime.count() / numUpdates);
+            totalUpdateTime = std::chrono::microseconds(0);
+            numUpdates = 0;
+        }
 
         // Present the rendered frame
         SDL_RenderPresent(renderer);
@@ -2,12 +2,14 @@
 #include <stdexcept>
 #include <algorithm>
 #include <functional>
+#include <string>
 #include "Core/World.h"
 #include "Core/Entity.h"
 #include "Core/Archetypes.h"
 #include "Core/ArchetypesRegistry.h"
 #include "Core/PackedComponentArray.h"
 #include "Core/ComponentData.h"
+#include "Containers/VirtualMemoryRegion.h"
 
 using ::testing::Test;
 
@@ -41,6 +43,29 @@ public:
         int m_value = 0;
     };
 
+    struct alignas(64) AlignedComponent : public ecs::IComponent 
+    {
+    public:
+        AlignedComponent() {}
+        AlignedComponent(float value) : m_value(value) {}
+
+        float m_value = 0.0f;
+    };
+
+    struct TagComponent : public ecs::IComponent {};
+
+    struct StringComponent : public ecs::IComponent 
+    {
+    public:
+        StringComponent() : m_value("a string long enough to never fit the small buffer") { s_numAlive++; }
+        StringComponent(const StringComponent& other) : m_value(other.m_value) { s_numAlive++; }
+        StringComponent(StringComponent&& other) noexcept : m_value(std::move(other.m_value)) { s_numAlive++; }
+        ~StringComponent() { s_numAlive--; }
+
+        std::string m_value;
+        static inline int s_numAlive = 0;
+    };
+
 protected:
     void SetUp() override
     {
@@ -233,6 +258,26 @@ TEST_F(TestArchetypes, TestDeleteComponentFromPackedArray)
     EXPECT_EQ(packedArray.capacity(), 8);
 }
 
+TEST_F(TestArchetypes, TestShrinkPackedComponentArray)
+{
+    ecs::packed_component_array<FloatComponent> packedArray(m_componentsRegistry.get());
+    for (int i = 0; i < 20; ++i)
+    {
+        packedArray.add_component().m_value = static_cast<float>(i);
+    }
+    packedArray.delete_at(0);
+    EXPECT_GT(packedArray.capacity(), packedArray.size());
+
+    EXPECT_TRUE(packedArray.shrink_to_fit());
+    EXPECT_EQ(packedArray.capacity(), 19);
+    EXPECT_FALSE(packedArray.shrink_to_fit()) << "Nothing is left to release";
+    EXPECT_NEAR(packedArray.get_component(0).m_value, 19.0f, 0.0001f);
+    EXPECT_NEAR(packedArray.get_component(18).m_value, 18.0f, 0.0001f);
+
+    packedArray.add_component().m_value = 20.0f;
+    EXPECT_NEAR(packedArray.get_component(19).m_value, 20.0f, 0.0001f);
+}
+
 TEST_F(TestArchetypes, TestTemplatePackedComponentArray)
 {
     ecs::packed_component_array<FloatComponent> packedArray(m_componentsRegistry.get());
@@ -359,3 +404,469 @@ TEST_F(TestArchetypes, TestComplexUpdateOfArchetypes)
     m_archetypesRegistry->ForEachEntity<IntComponent>(countInts);
     EXPECT_EQ(numInts, 5);
 }
+
+TEST_F(TestArchetypes, TestQueriesTrackArchetypes)
+{
+    size_t numInts = 0;
+    std::function<void(ecs::EntityHandle, IntComponent&)> countInts = 
+        [&numInts](ecs::EntityHandle entity, IntComponent& intComponent) { ++numInts; };
+
+    m_archetypesRegistry->AddEntity<IntComponent>(0);
+    m_archetypesRegistry->ForEachEntity<IntComponent>(countInts);
+    EXPECT_EQ(numInts, 1);
+
+    // archetypes created after the first run of the query are matched as well
+    m_archetypesRegistry->AddEntity<IntComponent, DoubleComponent>(1);
+    m_archetypesRegistry->AddEntity<DoubleComponent>(2);
+    const ecs::archetype_id intDoubleArchetypeID = m_archetypesRegistry->GetArchetypeID(1);
+    numInts = 0;
+    m_archetypesRegistry->ForEachEntity<IntComponent>(countInts);
+    EXPECT_EQ(numInts, 2);
+
+    // retired archetypes are forgotten, and their IDs are only matched again by matching archetypes
+    m_archetypesRegistry->RemoveEntity(1);
+    m_archetypesRegistry->Compact();
+    m_archetypesRegistry->AddEntity<FloatComponent>(3);
+    ASSERT_EQ(m_archetypesRegistry->GetArchetypeID(3), intDoubleArchetypeID);
+    numInts = 0;
+    m_archetypesRegistry->ForEachEntity<IntComponent>(countInts);
+    EXPECT_EQ(numInts, 1);
+
+    m_archetypesRegistry->AddEntity<IntComponent, FloatComponent>(4);
+    numInts = 0;
+    m_archetypesRegistry->ForEachEntity<IntComponent>(countInts);
+    EXPECT_EQ(numInts, 2);
+}
+
+TEST_F(TestArchetypes, TestChunkLayout)
+{
+    ecs::component_data floatComponentData;
+    ecs::component_data doubleComponentData;
+    ASSERT_TRUE(m_componentsRegistry->TryGetComponentData(typeid(FloatComponent), floatComponentData));
+    ASSERT_TRUE(m_componentsRegistry->TryGetComponentData(typeid(DoubleComponent), doubleComponentData));
+
+    const ecs::chunk_layout_t layout({ doubleComponentData, floatComponentData });
+    ASSERT_EQ(layout.num_columns(), 2);
+    EXPECT_LT(layout.column(0).componentID, layout.column(1).componentID)
+        << "Columns of a chunk should be sorted by component ID";
+    EXPECT_EQ(layout.chunk_size(), ARCHETYPE_CHUNK_SIZE);
+    EXPECT_GT(layout.rows_per_chunk(), 1);
+
+    for (const ecs::chunk_column_t& column : layout.columns())
+    {
+        EXPECT_LE(column.offset + column.componentSize * layout.rows_per_chunk(), layout.chunk_size())
+            << "All the columns should fit in the chunk";
+    }
+
+    EXPECT_EQ(layout.column_index(floatComponentData.serial()), 
+        floatComponentData.serial() < doubleComponentData.serial() ? 0 : 1);
+    EXPECT_EQ(layout.column(layout.column_index(doubleComponentData.serial())).componentID, doubleComponentData.serial());
+
+    ecs::component_data intComponentData;
+    ASSERT_TRUE(m_componentsRegistry->TryGetComponentData(typeid(IntComponent), intComponentData));
+    EXPECT_EQ(layout.column_index(intComponentData.serial()), layout.num_columns())
+        << "Components without a column should map to the number of columns";
+    EXPECT_EQ(layout.column_index(MAX_COMPONENTS - 1), layout.num_columns());
+}
+
+TEST_F(TestArchetypes, TestComponentAlignment)
+{
+    const ecs::component_data alignedComponentData = m_componentsRegistry->GetOrAddComponentData<AlignedComponent>();
+    EXPECT_EQ(alignedComponentData.alignment(), 64) 
+        << "The alignment of a component should be captured when it is registered";
+
+    ecs::packed_component_array<AlignedComponent> packedArray(m_componentsRegistry.get());
+    for (size_t i = 0; i < 20; ++i)
+    {
+        packedArray.emplace_component(static_cast<float>(i));
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(packedArray.data()) % alignof(AlignedComponent), 0)
+            << "Packed arrays should honor the alignment of their components, even after growing";
+    }
+
+    EXPECT_FLOAT_EQ(packedArray.get_component(19).m_value, 19.0f) 
+        << "Growing a packed array should preserve its components";
+    packedArray.delete_at(3);
+    EXPECT_FLOAT_EQ(packedArray.get_component(3).m_value, 19.0f)
+        << "Deleting a component should move the last component in its place";
+
+    for (ecs::entity_id entity = 0; entity < 1000; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<FloatComponent, AlignedComponent>(entity);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(&m_archetypesRegistry->GetComponent<AlignedComponent>(entity)) % 64, 0)
+            << "Chunk columns should honor the alignment of their components";
+    }
+}
+
+TEST_F(TestArchetypes, TestCacheLinePaddedChunkLayout)
+{
+    ecs::component_data floatComponentData;
+    ecs::component_data intComponentData;
+    ASSERT_TRUE(m_componentsRegistry->TryGetComponentData(typeid(FloatComponent), floatComponentData));
+    ASSERT_TRUE(m_componentsRegistry->TryGetComponentData(typeid(IntComponent), intComponentData));
+
+    const ecs::chunk_layout_t layout({ floatComponentData, intComponentData }, ARCHETYPE_CHUNK_SIZE, true);
+    EXPECT_EQ(layout.alignment(), CACHE_LINE_SIZE);
+    for (const ecs::chunk_column_t& column : layout.columns())
+    {
+        EXPECT_EQ(column.offset % CACHE_LINE_SIZE, 0) << "Padded columns should start on a cache line";
+        EXPECT_LE(column.offset + column.componentSize * layout.rows_per_chunk(), layout.chunk_size());
+    }
+
+    ecs::chunk_block_t block(layout, 3);
+    for (size_t chunkIndex = 0; chunkIndex < block.num_chunks(); ++chunkIndex)
+    {
+        const ecs::archetype_chunk_t chunk = block.get_chunk(chunkIndex);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(chunk.column_data(layout.column(1))) % CACHE_LINE_SIZE, 0);
+    }
+}
+
+TEST_F(TestArchetypes, TestEntitiesSpanMultipleChunks)
+{
+    constexpr size_t numEntities = 5000;
+    for (size_t entity = 0; entity < numEntities; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<FloatComponent, IntComponent>(entity);
+        m_archetypesRegistry->GetComponent<IntComponent>(entity).m_value = static_cast<int>(entity);
+    }
+
+    const ecs::archetype_id archetypeID = m_archetypesRegistry->GetArchetypeID(0);
+    EXPECT_GT(m_archetypesRegistry->GetNumChunksForArchetype(archetypeID), 1);
+
+    for (size_t entity = 0; entity < numEntities; ++entity)
+    {
+        ASSERT_EQ(m_archetypesRegistry->GetComponent<IntComponent>(entity).m_value, static_cast<int>(entity))
+            << "Adding chunks should never move or lose the data of already existing rows";
+    }
+
+    // removing an entity from the first chunk moves the last row across chunks
+    m_archetypesRegistry->RemoveEntity(0);
+    EXPECT_EQ(m_archetypesRegistry->GetComponent<IntComponent>(numEntities - 1).m_value, 
+        static_cast<int>(numEntities - 1));
+    EXPECT_EQ(m_archetypesRegistry->GetNumEntitiesForArchetype(archetypeID), numEntities - 1);
+}
+
+TEST_F(TestArchetypes, TestVirtualMemoryRegion)
+{
+    ecs::virtual_memory_region_t region(size_t(64) << 20, true);
+    if (!region.is_valid())
+    {
+        GTEST_SKIP() << "Virtual memory regions are not available on this platform";
+    }
+
+    EXPECT_EQ(region.size(), 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(region.data()) % ecs::virtual_memory_region_t::HUGE_PAGE_SIZE, 0)
+        << "The region should be aligned to huge pages";
+
+    std::byte* first = region.grow(1000);
+    ASSERT_EQ(first, region.data());
+    first[999] = std::byte{42};
+
+    std::byte* second = region.grow(ecs::virtual_memory_region_t::HUGE_PAGE_SIZE);
+    ASSERT_EQ(second, first + 1000) << "The region should grow in place";
+    second[ecs::virtual_memory_region_t::HUGE_PAGE_SIZE - 1] = std::byte{7};
+    EXPECT_EQ(first[999], std::byte{42}) << "Growing the region should never move its content";
+
+    EXPECT_EQ(region.grow(region.capacity()), nullptr) << "The region can't grow past its reserved size";
+
+    region.shrink(1000);
+    EXPECT_EQ(region.size(), 1000);
+    EXPECT_EQ(first[999], std::byte{42}) << "Shrinking the region should keep the content before the new size";
+}
+
+TEST_F(TestArchetypes, TestHugePageChunksAreContiguous)
+{
+    m_archetypesRegistry->SetChunkAllocator(ecs::EChunkAllocator::HugePages);
+
+    ecs::component_data intComponentData;
+    ASSERT_TRUE(m_componentsRegistry->TryGetComponentData(typeid(IntComponent), intComponentData));
+    const ecs::chunk_layout_t layout({ intComponentData });
+
+    const size_t numEntities = layout.rows_per_chunk() * 4;
+    for (ecs::entity_id entity = 0; entity < numEntities; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<IntComponent>(entity);
+        m_archetypesRegistry->GetComponent<IntComponent>(entity).m_value = static_cast<int>(entity);
+    }
+
+    const ecs::archetype_id archetypeID = m_archetypesRegistry->GetArchetypeID(0);
+    ASSERT_EQ(m_archetypesRegistry->GetNumChunksForArchetype(archetypeID), 4);
+    for (ecs::entity_id entity = 0; entity < numEntities; ++entity)
+    {
+        ASSERT_EQ(m_archetypesRegistry->GetComponent<IntComponent>(entity).m_value, static_cast<int>(entity));
+    }
+
+#if ECS_VIRTUAL_MEMORY_REGIONS
+    const std::byte* firstChunkRow = reinterpret_cast<const std::byte*>(&m_archetypesRegistry->GetComponent<IntComponent>(0));
+    for (size_t chunkIndex = 1; chunkIndex < 4; ++chunkIndex)
+    {
+        const std::byte* chunkRow = reinterpret_cast<const std::byte*>(
+            &m_archetypesRegistry->GetComponent<IntComponent>(chunkIndex * layout.rows_per_chunk()));
+        EXPECT_EQ(chunkRow - firstChunkRow, static_cast<ptrdiff_t>(chunkIndex * layout.chunk_stride()))
+            << "Chunks allocated from huge pages should be contiguous";
+    }
+#endif
+
+    // the region shrinks in place, keeping the rows still in use
+    for (ecs::entity_id entity = layout.rows_per_chunk(); entity < numEntities; ++entity)
+    {
+        m_archetypesRegistry->RemoveEntity(entity);
+    }
+
+    m_archetypesRegistry->Compact();
+    EXPECT_EQ(m_archetypesRegistry->GetNumChunksForArchetype(archetypeID), 1);
+    for (ecs::entity_id entity = 0; entity < layout.rows_per_chunk(); ++entity)
+    {
+        ASSERT_EQ(m_archetypesRegistry->GetComponent<IntComponent>(entity).m_value, static_cast<int>(entity));
+    }
+}
+
+TEST_F(TestArchetypes, TestForEachEntityVisitsRowsInOrder)
+{
+    for (ecs::entity_id entity = 0; entity < 10; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<IntComponent>(entity);
+    }
+
+    std::vector<ecs::entity_id> visitedEntities;
+    std::function<void(ecs::EntityHandle, IntComponent&)> collectEntities = 
+        [&visitedEntities](ecs::EntityHandle entity, IntComponent&) { visitedEntities.push_back(entity.id()); };
+    m_archetypesRegistry->ForEachEntity<IntComponent>(collectEntities);
+    EXPECT_EQ(visitedEntities, std::vector<ecs::entity_id>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }))
+        << "Entities should be visited in the order of their rows";
+
+    // the last row fills the hole left by the removed entity
+    m_archetypesRegistry->RemoveEntity(2);
+    visitedEntities.clear();
+    m_archetypesRegistry->ForEachEntity<IntComponent>(collectEntities);
+    EXPECT_EQ(visitedEntities, std::vector<ecs::entity_id>({ 0, 1, 9, 3, 4, 5, 6, 7, 8 }));
+}
+
+TEST_F(TestArchetypes, TestEntityLocationsAfterArchetypeChanges)
+{
+    for (ecs::entity_id entity = 0; entity < 4; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<IntComponent>(entity);
+        m_archetypesRegistry->GetComponent<IntComponent>(entity).m_value = static_cast<int>(entity) * 10;
+    }
+
+    // moving entity 1 to another archetype moves entity 3 into its old row
+    m_archetypesRegistry->AddComponent<FloatComponent>(1);
+    for (ecs::entity_id entity = 0; entity < 4; ++entity)
+    {
+        EXPECT_EQ(m_archetypesRegistry->GetComponent<IntComponent>(entity).m_value, static_cast<int>(entity) * 10);
+    }
+
+    m_archetypesRegistry->RemoveEntity(0);
+    EXPECT_EQ(m_archetypesRegistry->FindComponent<IntComponent>(0), nullptr);
+    ASSERT_THROW(m_archetypesRegistry->GetArchetypeID(0), std::out_of_range);
+    EXPECT_EQ(m_archetypesRegistry->GetComponent<IntComponent>(3).m_value, 30);
+
+    // IDs of removed entities can be registered again
+    m_archetypesRegistry->AddEntity<FloatComponent>(0);
+    EXPECT_EQ(m_archetypesRegistry->FindComponent<IntComponent>(0), nullptr);
+    EXPECT_NE(m_archetypesRegistry->FindComponent<FloatComponent>(0), nullptr);
+}
+
+TEST_F(TestArchetypes, TestRepeatedStructuralChanges)
+{
+    m_archetypesRegistry->AddEntity<IntComponent, DoubleComponent>(0);
+    m_archetypesRegistry->AddEntity<IntComponent, DoubleComponent>(1);
+    m_archetypesRegistry->GetComponent<IntComponent>(0).m_value = 7;
+    m_archetypesRegistry->GetComponent<DoubleComponent>(0).m_value = 2.5;
+    const ecs::archetype_id sourceArchetypeID = m_archetypesRegistry->GetArchetypeID(0);
+
+    for (int iteration = 0; iteration < 3; ++iteration)
+    {
+        m_archetypesRegistry->AddComponent<FloatComponent>(0);
+        m_archetypesRegistry->GetComponent<FloatComponent>(0).m_value = 1.5f;
+        EXPECT_NE(m_archetypesRegistry->GetArchetypeID(0), sourceArchetypeID);
+
+        m_archetypesRegistry->AddComponent<FloatComponent>(1);
+        EXPECT_EQ(m_archetypesRegistry->GetArchetypeID(0), m_archetypesRegistry->GetArchetypeID(1))
+            << "The same transition should always lead to the same archetype";
+
+        m_archetypesRegistry->RemoveComponent<FloatComponent>(0);
+        m_archetypesRegistry->RemoveComponent<FloatComponent>(1);
+        EXPECT_EQ(m_archetypesRegistry->GetArchetypeID(0), sourceArchetypeID);
+        EXPECT_EQ(m_archetypesRegistry->GetArchetypeID(1), sourceArchetypeID);
+    }
+
+    EXPECT_EQ(m_archetypesRegistry->GetNumArchetypes(), 2);
+    EXPECT_EQ(m_archetypesRegistry->GetComponent<IntComponent>(0).m_value, 7);
+    EXPECT_EQ(m_archetypesRegistry->GetComponent<DoubleComponent>(0).m_value, 2.5);
+    EXPECT_EQ(m_archetypesRegistry->FindComponent<FloatComponent>(0), nullptr);
+}
+
+TEST_F(TestArchetypes, TestSignatureSetOperations)
+{
+    const ecs::archetype::Signature signature = { 3, 64, 1000, 2047 };
+    EXPECT_EQ(signature.size(), 4);
+    EXPECT_TRUE(signature.contains(1000));
+    EXPECT_FALSE(signature.contains(4));
+
+    std::vector<ecs::component_id> componentIDs(signature.begin(), signature.end());
+    EXPECT_EQ(componentIDs, std::vector<ecs::component_id>({ 3, 64, 1000, 2047 }));
+
+    EXPECT_TRUE(signature.contains_all({ 64, 2047 }));
+    EXPECT_TRUE(signature.contains_all({}));
+    EXPECT_FALSE(signature.contains_all({ 3, 65 }));
+    EXPECT_TRUE(signature.intersects({ 5, 1000 }));
+    EXPECT_FALSE(signature.intersects({ 5, 1001 }));
+
+    ecs::archetype::Signature sameComponents = { 2047, 1000, 64 };
+    sameComponents.insert(3);
+    EXPECT_EQ(signature, sameComponents);
+    EXPECT_EQ(signature.hash(), sameComponents.hash()) 
+        << "The hash of a signature should not depend on the insertion order";
+
+    sameComponents.erase(64);
+    EXPECT_NE(signature, sameComponents);
+    EXPECT_NE(signature.hash(), sameComponents.hash());
+    ASSERT_THROW(sameComponents.insert(MAX_COMPONENTS), std::out_of_range);
+}
+
+TEST_F(TestArchetypes, TestComponentLifecycleOps)
+{
+    EXPECT_TRUE(ecs::component_ops_t::make<FloatComponent>().is_trivially_copyable());
+    EXPECT_FALSE(ecs::component_ops_t::make<StringComponent>().is_trivially_copyable());
+
+    const std::string defaultValue = StringComponent().m_value;
+    for (ecs::entity_id entity = 0; entity < 1000; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<StringComponent>(entity);
+        EXPECT_EQ(m_archetypesRegistry->GetComponent<StringComponent>(entity).m_value, defaultValue)
+            << "Components should be default-constructed when an entity is added";
+        m_archetypesRegistry->GetComponent<StringComponent>(entity).m_value = std::to_string(entity) + defaultValue;
+    }
+    EXPECT_EQ(StringComponent::s_numAlive, 1000);
+
+    for (ecs::entity_id entity = 0; entity < 1000; entity += 2)
+    {
+        m_archetypesRegistry->AddComponent<IntComponent>(entity);
+    }
+
+    for (ecs::entity_id entity = 0; entity < 1000; entity += 3)
+    {
+        m_archetypesRegistry->RemoveEntity(entity);
+    }
+
+    int numEntities = 0;
+    for (ecs::entity_id entity = 0; entity < 1000; ++entity)
+    {
+        if (entity % 3 != 0)
+        {
+            numEntities++;
+            EXPECT_EQ(m_archetypesRegistry->GetComponent<StringComponent>(entity).m_value, std::to_string(entity) + defaultValue)
+                << "Moving rows around should preserve non-trivial components";
+        }
+    }
+    EXPECT_EQ(StringComponent::s_numAlive, numEntities) << "Removed components should be destroyed";
+
+    const std::vector<ecs::entity_id> removedEntities = { 1, 2, 4, 5, 7, 998 };
+    m_archetypesRegistry->RemoveEntities(removedEntities);
+    EXPECT_EQ(StringComponent::s_numAlive, numEntities - static_cast<int>(removedEntities.size()))
+        << "Components removed in bulk should be destroyed";
+    EXPECT_EQ(m_archetypesRegistry->GetComponent<StringComponent>(997).m_value, std::to_string(997) + defaultValue);
+
+    m_archetypesRegistry->Reset();
+    EXPECT_EQ(StringComponent::s_numAlive, 0) << "Destroying an archetype should destroy all of its components";
+
+    {
+        ecs::packed_component_array<StringComponent> packedArray(m_componentsRegistry.get());
+        for (int i = 0; i < 20; ++i)
+        {
+            packedArray.emplace_component().m_value = std::to_string(i);
+        }
+        packedArray.delete_at(0);
+        EXPECT_EQ(packedArray.get_component(0).m_value, "19");
+        EXPECT_EQ(packedArray.get_component(18).m_value, "18");
+        EXPECT_EQ(StringComponent::s_numAlive, 19);
+    }
+    EXPECT_EQ(StringComponent::s_numAlive, 0);
+}
+
+TEST_F(TestArchetypes, TestReserve)
+{
+    constexpr size_t numEntities = 5000;
+    const ecs::archetype_id archetypeID = m_archetypesRegistry->Reserve<FloatComponent, IntComponent>(numEntities);
+    const size_t capacity = m_archetypesRegistry->GetCapacityForArchetype(archetypeID);
+    EXPECT_GE(capacity, numEntities);
+    EXPECT_EQ(m_archetypesRegistry->GetNumChunksForArchetype(archetypeID), 0)
+        << "Reserved chunks should not be visited until they hold some rows";
+
+    for (ecs::entity_id entity = 0; entity < numEntities; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<IntComponent, FloatComponent>(entity);
+    }
+    EXPECT_EQ(m_archetypesRegistry->GetArchetypeID(0), archetypeID);
+    EXPECT_EQ(m_archetypesRegistry->GetCapacityForArchetype(archetypeID), capacity)
+        << "Adding reserved entities should not allocate new chunks";
+
+    m_archetypesRegistry->Reserve(archetypeID, 10);
+    EXPECT_EQ(m_archetypesRegistry->GetCapacityForArchetype(archetypeID), capacity)
+        << "Reserving less than the current capacity should do nothing";
+    ASSERT_THROW(m_archetypesRegistry->Reserve(archetypeID + 1, 10), std::out_of_range);
+}
+
+TEST_F(TestArchetypes, TestChunkGrowthPolicy)
+{
+    ecs::chunk_growth_policy_t growthPolicy;
+    EXPECT_EQ(growthPolicy.get_num_chunks_to_allocate(0), 1);
+    EXPECT_EQ(growthPolicy.get_num_chunks_to_allocate(10), 1);
+
+    growthPolicy.minChunksPerAllocation = 2;
+    growthPolicy.growthFactor = 1.0f;
+    EXPECT_EQ(growthPolicy.get_num_chunks_to_allocate(0), 2);
+    EXPECT_EQ(growthPolicy.get_num_chunks_to_allocate(10), 10);
+
+    m_archetypesRegistry->SetChunkGrowthPolicy(growthPolicy);
+    m_archetypesRegistry->AddEntity<FloatComponent>(0);
+    const ecs::archetype_id archetypeID = m_archetypesRegistry->GetArchetypeID(0);
+    const size_t rowsPerChunk = m_archetypesRegistry->GetCapacityForArchetype(archetypeID) / 2;
+    EXPECT_EQ(m_archetypesRegistry->GetNumChunksForArchetype(archetypeID), 1);
+
+    for (ecs::entity_id entity = 1; entity <= rowsPerChunk * 2; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<FloatComponent>(entity);
+    }
+    EXPECT_EQ(m_archetypesRegistry->GetCapacityForArchetype(archetypeID), rowsPerChunk * 4)
+        << "A growth factor of 1 should double the capacity of the archetype";
+    EXPECT_EQ(m_archetypesRegistry->GetNumChunksForArchetype(archetypeID), 3);
+}
+
+TEST_F(TestArchetypes, TestTagComponents)
+{
+    const ecs::component_data tagComponentData = m_componentsRegistry->GetOrAddComponentData<TagComponent>();
+    EXPECT_TRUE(tagComponentData.is_tag()) << "Empty components should be registered as tags";
+    EXPECT_FALSE(m_componentsRegistry->GetOrAddComponentData<FloatComponent>().is_tag());
+
+    for (ecs::entity_id entity = 0; entity < 10; ++entity)
+    {
+        m_archetypesRegistry->AddEntity<FloatComponent>(entity);
+        m_archetypesRegistry->GetComponent<FloatComponent>(entity).m_value = static_cast<float>(entity);
+    }
+
+    m_archetypesRegistry->AddComponent<TagComponent>(3);
+    m_archetypesRegistry->AddComponent<TagComponent>(7);
+    const ecs::archetype_id taggedArchetypeID = m_archetypesRegistry->GetArchetypeID(3);
+    EXPECT_TRUE(m_archetypesRegistry->GetArchetype(3).has_component(tagComponentData.serial()))
+        << "Tags should be part of the signature of the archetype";
+    EXPECT_EQ(m_archetypesRegistry->GetNumEntitiesForArchetype(taggedArchetypeID), 2);
+    EXPECT_NE(m_archetypesRegistry->FindComponent<TagComponent>(7), nullptr);
+    EXPECT_EQ(m_archetypesRegistry->FindComponent<TagComponent>(6), nullptr);
+    EXPECT_FLOAT_EQ(m_archetypesRegistry->GetComponent<FloatComponent>(7).m_value, 7.0f);
+
+    std::vector<ecs::entity_id> taggedEntities;
+    std::function<void(ecs::EntityHandle, FloatComponent&, TagComponent&)> collectTaggedEntities = 
+        [&taggedEntities](ecs::EntityHandle entity, FloatComponent& floatComponent, TagComponent& tag) 
+        { 
+            taggedEntities.push_back(static_cast<ecs::entity_id>(floatComponent.m_value)); 
+        };
+    m_archetypesRegistry->ForEachEntity<FloatComponent, TagComponent>(collectTaggedEntities);
+    EXPECT_EQ(taggedEntities, std::vector<ecs::entity_id>({ 3, 7 }));
+
+    m_archetypesRegistry->RemoveComponent<TagComponent>(3);
+    EXPECT_EQ(m_archetypesRegistry->FindComponent<TagComponent>(3), nullptr);
+    EXPECT_FLOAT_EQ(m_archetypesRegistry->GetComponent<FloatComponent>(3).m_value, 3.0f);
+    ASSERT_THROW(m_archetypesRegistry->GetComponent<TagComponent>(3), std::out_of_range);
+}
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <memory>
+#include <atomic>
 #include <set>
+#include <vector>
 #include "Core/Types.h"
 #include "Core/Archetypes.h"
 #include "Core/World.h"
@@ -166,4 +168,80 @@ TEST_F(TestArchetypeQueries, TestQueryThatModifiesEntities)
         EXPECT_NE(entity.FindComponent<Velocity>(), nullptr);
         EXPECT_NEAR(position.x, 3.14f, 0.0001f);
     });
-}
\ No newline at end of file
+}
+
+TEST_F(TestArchetypeQueries, TestParallelForEach)
+{
+    // the same entities in two worlds, one of them updated in parallel
+    constexpr size_t numEntities = 20000;
+
+    // the fixture already made some entities with both position and velocity, but none with a scale
+    const size_t numMovingEntities = numEntities + static_cast<size_t>(CountEntities<Position, Velocity>());
+    std::shared_ptr<ecs::World> sequentialWorld = std::make_shared<ecs::World>();
+    sequentialWorld->Initialize();
+    m_world->SetNumThreads(4);
+    for (const std::shared_ptr<ecs::World>& world : { m_world, sequentialWorld })
+    {
+        std::vector<ecs::entity_id> entities(numEntities);
+        world->CreateEntities<Position, Velocity, Scale>(numEntities, entities, 
+            [](size_t index, Position& /*position*/, Velocity& velocity, Scale& /*scale*/) 
+            { 
+                velocity.x = static_cast<float>(index); 
+            });
+    }
+
+    std::atomic<size_t> numVisited{0};
+    ecs::query<Position, const Velocity>(m_world).parallelForEach(
+        [&numVisited](Position& position, const Velocity& velocity) 
+        { 
+            position.x += velocity.x; 
+            ++numVisited;
+        }, 100);
+    EXPECT_EQ(numVisited, numMovingEntities) << "All the entities with position and velocity should be visited once";
+    ecs::query<Position, const Velocity>(m_world).forEach([](Position& position, const Velocity& velocity)
+    {
+        EXPECT_EQ(position.x, velocity.x);
+    });
+
+    // structural changes are applied in the same order as in a sequential pass
+    const auto addRotations = [](ecs::EntityHandle entity, const Velocity& velocity, const Scale& /*scale*/)
+    {
+        if (static_cast<size_t>(velocity.x) % 3 == 0)
+        {
+            entity.DeferredAddComponent<Rotation>();
+        }
+    };
+    ecs::query<const Velocity, const Scale>(m_world).parallelForEach(addRotations);
+    ecs::query<const Velocity, const Scale>(sequentialWorld).forEach(addRotations);
+
+    std::vector<float> parallelOrder;
+    std::vector<float> sequentialOrder;
+    ecs::query<const Velocity, ecs::With<Rotation, Scale>>(m_world).forEach(
+        [&](const Velocity& velocity) { parallelOrder.push_back(velocity.x); });
+    ecs::query<const Velocity, ecs::With<Rotation, Scale>>(sequentialWorld).forEach(
+        [&](const Velocity& velocity) { sequentialOrder.push_back(velocity.x); });
+    const size_t numRotatedEntities = (numEntities + 2) / 3;
+    EXPECT_EQ(parallelOrder.size(), numRotatedEntities) << "The new entities with an index multiple of 3 should get a rotation";
+    EXPECT_EQ(parallelOrder, sequentialOrder);
+}
+
+TEST_F(TestArchetypeQueries, TestNestedParallelForEach)
+{
+    constexpr size_t numEntities = 2000;
+    const size_t numMovingEntities = numEntities + static_cast<size_t>(CountEntities<Velocity>());
+    m_world->SetNumThreads(2);
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position, Velocity>(numEntities, entities);
+
+    // a parallel pass from the function of another one fails rather than waiting for itself
+    const auto nestedPass = [this](Position& /*position*/)
+    {
+        ecs::query<const Velocity>(m_world).parallelForEach([](const Velocity& /*velocity*/) {}, 500);
+    };
+    EXPECT_THROW(ecs::query<Position>(m_world).parallelForEach(nestedPass, 500), std::logic_error);
+
+    // the world can still run parallel passes afterwards
+    std::atomic<size_t> numVisited{0};
+    ecs::query<const Velocity>(m_world).parallelForEach([&numVisited](const Velocity& /*velocity*/) { ++numVisited; }, 500);
+    EXPECT_EQ(numVisited, numMovingEntities);
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "Core/ThreadPool.h"
+
+TEST(TestThreadPool, TestParallelFor)
+{
+    ecs::ThreadPool threadPool(4);
+    EXPECT_EQ(threadPool.GetNumThreads(), 4u);
+
+    // every task runs exactly once, and each thread index is only used by one thread at a time
+    constexpr size_t numTasks = 1000;
+    std::vector<std::atomic<int>> numRuns(numTasks);
+    std::vector<std::atomic<int>> numRunningTasks(threadPool.GetNumThreads());
+    std::atomic<bool> overlapped{false};
+    threadPool.ParallelFor(numTasks, [&](size_t taskIndex, size_t threadIndex)
+    {
+        overlapped = overlapped || numRunningTasks[threadIndex].fetch_add(1) != 0;
+        ++numRuns[taskIndex];
+        numRunningTasks[threadIndex].fetch_sub(1);
+    });
+    EXPECT_FALSE(overlapped);
+    EXPECT_TRUE(std::all_of(numRuns.begin(), numRuns.end(), [](const std::atomic<int>& runs) { return runs == 1; }));
+
+    // the pool can be reused, and rethrows the exceptions of the tasks
+    const auto failingTask = [](size_t taskIndex, size_t /*threadIndex*/)
+    {
+        if (taskIndex == 10)
+        {
+            throw std::runtime_error("Task failed");
+        }
+    };
+    EXPECT_THROW(threadPool.ParallelFor(numTasks, failingTask), std::runtime_error);
+    size_t numSequentialRuns = 0;
+    ecs::ThreadPool(1).ParallelFor(10, [&](size_t /*taskIndex*/, size_t /*threadIndex*/) { ++numSequentialRuns; });
+    EXPECT_EQ(numSequentialRuns, 10u);
+}
+
+TEST(TestThreadPool, TestNestedParallelFor)
+{
+    // the tasks can't start a loop on their own pool, which would wait for them, whatever the number of threads
+    for (const size_t numThreads : { 1, 2 })
+    {
+        ecs::ThreadPool threadPool(numThreads);
+        const auto nestedTask = [&threadPool](size_t /*taskIndex*/, size_t /*threadIndex*/)
+        {
+            threadPool.ParallelFor(4, [](size_t /*taskIndex*/, size_t /*threadIndex*/) {});
+        };
+        EXPECT_THROW(threadPool.ParallelFor(4, nestedTask), std::logic_error);
+
+        // the pool is still usable afterwards, from the calling thread and from other pools
+        ecs::ThreadPool otherThreadPool(2);
+        std::atomic<size_t> numRuns{0};
+        threadPool.ParallelFor(4, [&](size_t /*taskIndex*/, size_t /*threadIndex*/)
+        {
+            otherThreadPool.ParallelFor(1, [&](size_t /*taskIndex*/, size_t /*threadIndex*/) { ++numRuns; });
+        });
+        EXPECT_EQ(numRuns, 4u);
+    }
+}
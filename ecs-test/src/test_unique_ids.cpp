@@ -63,4 +63,72 @@ TEST_F(TestIDGenerator, TestReset)
 
     m_ulongIDGenerator->Reset();
     EXPECT_EQ(m_ulongIDGenerator->GenerateNewUniqueID(), 0);
-}
\ No newline at end of file
+}
+TEST(TestGenerationalIDGenerator, TestSlotRecycling)
+{
+    using generator_t = ecs::GenerationalIDGenerator<unsigned long long, 32>;
+    generator_t generator;
+
+    const unsigned long long id0 = generator.GenerateNewUniqueID();
+    const unsigned long long id1 = generator.GenerateNewUniqueID();
+    EXPECT_EQ(generator_t::GetIndex(id0), 0);
+    EXPECT_EQ(generator_t::GetIndex(id1), 1);
+    EXPECT_EQ(generator_t::GetGeneration(id0), 0);
+
+    EXPECT_TRUE(generator.ReleaseID(id0));
+    EXPECT_FALSE(generator.ReleaseID(id0)) << "Releasing an ID twice should fail";
+    EXPECT_FALSE(generator.IsAlive(id0));
+
+    const unsigned long long recycledID = generator.GenerateNewUniqueID();
+    EXPECT_EQ(generator_t::GetIndex(recycledID), 0) << "Released slots should be reused";
+    EXPECT_EQ(generator_t::GetGeneration(recycledID), 1) << "Reused slots should have a new generation";
+    EXPECT_NE(recycledID, id0);
+    EXPECT_TRUE(generator.IsAlive(recycledID));
+    EXPECT_FALSE(generator.IsAlive(id0)) << "Stale IDs should never be considered alive";
+
+    EXPECT_EQ(generator.GetNumSlots(), 2);
+    EXPECT_EQ(generator.GetNumAliveIDs(), 2);
+}
+
+TEST(TestGenerationalIDGenerator, TestGenerationExhaustion)
+{
+    using generator_t = ecs::GenerationalIDGenerator<unsigned char, 6>;
+    generator_t generator;
+
+    // 2 generation bits: the slot is retired after generation 2 is released
+    unsigned char id = generator.GenerateNewUniqueID();
+    for (unsigned char generation = 0; generation < generator_t::MaxGeneration; ++generation)
+    {
+        EXPECT_EQ(generator_t::GetIndex(id), 0);
+        EXPECT_EQ(generator_t::GetGeneration(id), generation);
+        generator.ReleaseID(id);
+        id = generator.GenerateNewUniqueID();
+    }
+
+    EXPECT_EQ(generator_t::GetIndex(id), 1) << "Slots with an exhausted generation should never be reused";
+}
+
+TEST(TestGenerationalIDGenerator, TestBulkGeneration)
+{
+    using generator_t = ecs::GenerationalIDGenerator<unsigned long long, 32>;
+    generator_t generator;
+
+    const unsigned long long releasedID = generator.GenerateNewUniqueID();
+    generator.ReleaseID(releasedID);
+
+    std::vector<unsigned long long> ids(4);
+    generator.GenerateNewUniqueIDs(ids);
+    EXPECT_EQ(generator_t::GetIndex(ids[0]), 0) << "Released slots should be reused first";
+    EXPECT_EQ(generator_t::GetGeneration(ids[0]), 1);
+    for (size_t i = 1; i < ids.size(); ++i)
+    {
+        EXPECT_EQ(generator_t::GetIndex(ids[i]), i);
+        EXPECT_TRUE(generator.IsAlive(ids[i]));
+    }
+    EXPECT_EQ(generator.GetNumAliveIDs(), 4);
+
+    using small_generator_t = ecs::GenerationalIDGenerator<unsigned char, 2>;
+    small_generator_t smallGenerator;
+    std::vector<unsigned char> tooManyIDs(4);
+    ASSERT_THROW(smallGenerator.GenerateNewUniqueIDs(tooManyIDs), std::overflow_error);
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <map>
 #include "Core/World.h"
 #include "Core/Entity.h"
 #include "Core/ComponentData.h"
@@ -7,6 +8,34 @@
 
 using ::testing::Test; 
 
+namespace soa
+{
+    struct Body : public ecs::IComponent
+    {
+        ecs::real_t x = 1.0f;
+        double mass = 2.0;
+        char group = 'a';
+    };
+
+    struct Point : public ecs::IComponent
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+    };
+}
+
+ECS_SOA_COMPONENT(soa::Body, x, mass, group)
+
+/* A field list ECS_SOA_COMPONENT rejects, declared by hand: x is listed twice and y has no field at all. */
+template<>
+struct ecs::soa_fields<soa::Point>
+{
+    static constexpr auto members = std::make_tuple(&soa::Point::x, &soa::Point::x);
+};
+
+static_assert(ecs::soa_fields_complete_v<soa::Body>);
+static_assert(!ecs::soa_fields_complete_v<soa::Point>, "Fields listed twice should be rejected");
+
 class TestECSWorld : public Test 
 {
 public:
@@ -56,6 +85,15 @@ protected:
         m_world.reset();
     }
 
+    template<typename... Components>
+    size_t CountEntities()
+    {
+        size_t count = 0;
+        ecs::query<Components...>::MakeQuery(m_world).forEach(
+            [&count](ecs::EntityHandle entity, auto&&... components) { ++count; });
+        return count;
+    }
+
     std::shared_ptr<ecs::World> m_world;
 };
 
@@ -237,3 +275,557 @@ TEST_F(TestECSWorld, TestUpdate)
     EXPECT_EQ(e2Handle.GetComponent<Position>().x, 4.0f);
     EXPECT_EQ(e2Handle.GetComponent<Position>().y, 0.0f);
 }
+
+TEST_F(TestECSWorld, TestDestroyEntity)
+{
+    ecs::entity_id entity = m_world->CreateEntity<Position>();
+    ecs::EntityHandle entityHandle = m_world->GetEntity(entity);
+    EXPECT_TRUE(entityHandle.IsValid());
+
+    EXPECT_TRUE(m_world->DestroyEntity(entity));
+    EXPECT_FALSE(m_world->DestroyEntity(entity)) << "Destroying an entity twice should do nothing";
+    EXPECT_FALSE(m_world->IsEntityAlive(entity));
+    EXPECT_FALSE(entityHandle.IsValid());
+    EXPECT_EQ(entityHandle.FindComponent<Position>(), nullptr);
+
+    // the slot of the destroyed entity is recycled, but stale handles can not reach the new entity
+    ecs::entity_id newEntity = m_world->CreateEntity<Position>();
+    EXPECT_EQ(ecs::entity_index(newEntity), ecs::entity_index(entity));
+    EXPECT_NE(newEntity, entity);
+    EXPECT_TRUE(m_world->GetEntity(newEntity).IsValid());
+    EXPECT_FALSE(entityHandle.IsValid());
+    EXPECT_EQ(entityHandle.FindComponent<Position>(), nullptr);
+    ASSERT_THROW(m_world->GetEntity(entity), std::out_of_range);
+}
+
+TEST_F(TestECSWorld, TestCreateEntities)
+{
+    constexpr size_t numEntities = 3000;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position, Velocity>(numEntities, entities, 
+        [](size_t index, Position& position, Velocity& velocity)
+        {
+            position.x = static_cast<ecs::real_t>(index);
+            velocity.y = -static_cast<ecs::real_t>(index);
+        });
+
+    for (size_t i = 0; i < numEntities; ++i)
+    {
+        ASSERT_TRUE(m_world->IsEntityAlive(entities[i]));
+        ecs::EntityHandle handle = m_world->GetEntity(entities[i]);
+        EXPECT_EQ(handle.GetComponent<Position>().x, static_cast<ecs::real_t>(i));
+        EXPECT_EQ(handle.GetComponent<Position>().y, 0.0f);
+        EXPECT_EQ(handle.GetComponent<Velocity>().y, -static_cast<ecs::real_t>(i));
+    }
+
+    const ecs::archetype_id archetypeID = m_world->GetArchetypesRegistry()->GetArchetypeID(entities[0]);
+    EXPECT_EQ(m_world->GetArchetypesRegistry()->GetNumEntitiesForArchetype(archetypeID), numEntities);
+
+    // entities created one by one end up in the same archetype
+    const ecs::entity_id entity = m_world->CreateEntity<Velocity, Position>();
+    EXPECT_EQ(m_world->GetArchetypesRegistry()->GetArchetypeID(entity), archetypeID);
+
+    std::vector<ecs::entity_id> moreEntities(2);
+    m_world->CreateEntities<Rotation>(2, moreEntities);
+    EXPECT_EQ(m_world->GetEntity(moreEntities[1]).GetComponent<Rotation>().angle, 0.0f);
+    ASSERT_THROW(m_world->CreateEntities<Rotation>(3, moreEntities), std::invalid_argument);
+}
+
+TEST_F(TestECSWorld, TestDestroyEntities)
+{
+    constexpr size_t numEntities = 3000;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position>(numEntities, entities, 
+        [](size_t index, Position& position) { position.x = static_cast<ecs::real_t>(index); });
+    std::vector<ecs::entity_id> rotatingEntities(10);
+    m_world->CreateEntities<Position, Rotation>(10, rotatingEntities);
+
+    // a contiguous block, a scattered pattern, the tail of the archetype and entities from another archetype
+    std::vector<ecs::entity_id> destroyedEntities;
+    for (size_t i = 0; i < numEntities; ++i)
+    {
+        if ((i >= 100 && i < 600) || i % 7 == 0 || i >= numEntities - 50)
+        {
+            destroyedEntities.push_back(entities[i]);
+        }
+    }
+    const size_t numDestroyedEntities = destroyedEntities.size();
+    destroyedEntities.push_back(entities[0]);
+    destroyedEntities.push_back(rotatingEntities[3]);
+
+    EXPECT_EQ(m_world->DestroyEntities(destroyedEntities), numDestroyedEntities + 1)
+        << "Duplicated IDs should only be destroyed once";
+    EXPECT_EQ(m_world->DestroyEntities(destroyedEntities), 0) << "Stale IDs should be ignored";
+
+    const ecs::archetype_id archetypeID = m_world->GetArchetypesRegistry()->GetArchetypeID(entities[1]);
+    EXPECT_EQ(m_world->GetArchetypesRegistry()->GetNumEntitiesForArchetype(archetypeID), 
+        numEntities - numDestroyedEntities);
+
+    for (size_t i = 0; i < numEntities; ++i)
+    {
+        const bool isDestroyed = (i >= 100 && i < 600) || i % 7 == 0 || i >= numEntities - 50;
+        ASSERT_EQ(m_world->IsEntityAlive(entities[i]), !isDestroyed);
+        if (!isDestroyed)
+        {
+            EXPECT_EQ(m_world->GetEntity(entities[i]).GetComponent<Position>().x, static_cast<ecs::real_t>(i))
+                << "Surviving entities should keep their components after compaction";
+        }
+    }
+
+    EXPECT_FALSE(m_world->IsEntityAlive(rotatingEntities[3]));
+    EXPECT_TRUE(m_world->GetEntity(rotatingEntities[9]).IsValid());
+}
+
+TEST_F(TestECSWorld, TestSingletons)
+{
+    struct InputState
+    {
+        InputState(ecs::real_t horizontalAxis) : m_horizontalAxis(horizontalAxis) {}
+        ecs::real_t m_horizontalAxis = 0.0f;
+    };
+
+    EXPECT_EQ(m_world->FindSingleton<InputState>(), nullptr);
+    ASSERT_THROW(m_world->GetSingleton<InputState>(), std::out_of_range);
+
+    InputState& inputState = m_world->SetSingleton<InputState>(0.5f);
+    EXPECT_EQ(&m_world->GetSingleton<InputState>(), &inputState);
+    EXPECT_EQ(m_world->GetSingleton<InputState>().m_horizontalAxis, 0.5f);
+
+    m_world->SetSingleton<Position>().x = 3.0f;
+    EXPECT_EQ(m_world->GetSingleton<Position>().x, 3.0f);
+    EXPECT_EQ(m_world->GetSingleton<InputState>().m_horizontalAxis, 0.5f) 
+        << "Singletons of different types should not interfere";
+
+    m_world->SetSingleton<InputState>(-1.0f);
+    EXPECT_EQ(m_world->GetSingleton<InputState>().m_horizontalAxis, -1.0f) << "Setting a singleton should replace it";
+
+    int numPositions = 0;
+    ecs::query<Position>::MakeQuery(m_world).forEach(
+        [&numPositions](ecs::EntityHandle entity, Position& position) { ++numPositions; });
+    EXPECT_EQ(numPositions, 0) << "Singletons should never be matched by queries";
+
+    EXPECT_TRUE(m_world->RemoveSingleton<InputState>());
+    EXPECT_FALSE(m_world->RemoveSingleton<InputState>());
+    EXPECT_EQ(m_world->FindSingleton<InputState>(), nullptr);
+}
+
+TEST_F(TestECSWorld, TestSparseSetComponents)
+{
+    struct Stunned : public ecs::IComponent 
+    {
+    public:
+        ecs::real_t remainingTime = 1.0f;
+    };
+
+    m_world->GetComponentsRegistry()->RegisterComponent<Stunned>(8, ecs::EComponentStorage::SparseSet);
+    ASSERT_THROW(m_world->GetComponentsRegistry()->RegisterComponent<Stunned>(), std::logic_error)
+        << "The storage of a component can't change once registered";
+
+    ecs::EntityHandle entity = m_world->GetEntity(m_world->CreateEntity<Position>());
+    ecs::EntityHandle otherEntity = m_world->GetEntity(m_world->CreateEntity<Position, Stunned>());
+    const ecs::archetype_id archetypeID = entity.archetypeID();
+    const size_t numArchetypes = m_world->GetArchetypesRegistry()->GetNumArchetypes();
+    EXPECT_EQ(otherEntity.archetypeID(), archetypeID) << "Sparse components should not be part of archetypes";
+    EXPECT_NE(otherEntity.FindComponent<Stunned>(), nullptr);
+
+    entity.GetComponent<Position>().x = 2.0f;
+    entity.AddComponent<Stunned>();
+    entity.GetComponent<Stunned>().remainingTime = 3.0f;
+    EXPECT_EQ(entity.archetypeID(), archetypeID) << "Adding a sparse component should not move the entity";
+    EXPECT_EQ(m_world->GetArchetypesRegistry()->GetNumArchetypes(), numArchetypes);
+    EXPECT_EQ(entity.GetComponent<Position>().x, 2.0f);
+
+    int numStunnedEntities = 0;
+    ecs::query<Position, Stunned>::MakeQuery(m_world).forEach(
+        [&](ecs::EntityHandle handle, Position& position, Stunned& stunned) 
+        { 
+            ++numStunnedEntities;
+            if (handle.id() == entity.id())
+            {
+                EXPECT_EQ(position.x, 2.0f);
+                EXPECT_EQ(stunned.remainingTime, 3.0f);
+            }
+        });
+    EXPECT_EQ(numStunnedEntities, 2) << "Queries should mix archetype and sparse components";
+
+    entity.RemoveComponent<Stunned>();
+    EXPECT_EQ(entity.FindComponent<Stunned>(), nullptr);
+    ASSERT_THROW(entity.GetComponent<Stunned>(), std::out_of_range);
+    EXPECT_EQ(entity.archetypeID(), archetypeID);
+
+    numStunnedEntities = 0;
+    ecs::query<Stunned>::MakeQuery(m_world).forEach(
+        [&numStunnedEntities](ecs::EntityHandle handle, Stunned& stunned) { ++numStunnedEntities; });
+    EXPECT_EQ(numStunnedEntities, 1);
+
+    // destroyed entities lose their sparse components too, even if their index gets recycled
+    const ecs::entity_id destroyedEntity = otherEntity.id();
+    m_world->DestroyEntity(destroyedEntity);
+    ecs::EntityHandle recycledEntity = m_world->GetEntity(m_world->CreateEntity<Position>());
+    EXPECT_EQ(ecs::entity_index(recycledEntity.id()), ecs::entity_index(destroyedEntity));
+    EXPECT_EQ(recycledEntity.FindComponent<Stunned>(), nullptr);
+
+    numStunnedEntities = 0;
+    ecs::query<Stunned>::MakeQuery(m_world).forEach(
+        [&numStunnedEntities](ecs::EntityHandle handle, Stunned& stunned) { ++numStunnedEntities; });
+    EXPECT_EQ(numStunnedEntities, 0);
+}
+
+TEST_F(TestECSWorld, TestEnableableComponents)
+{
+    struct Frozen : public ecs::IComponent {};
+
+    m_world->GetComponentsRegistry()->RegisterComponent<Velocity>(8, ecs::EComponentStorage::Archetype, true);
+    m_world->GetComponentsRegistry()->RegisterComponent<Frozen>(8, ecs::EComponentStorage::Archetype, true);
+    ASSERT_THROW(m_world->GetComponentsRegistry()->RegisterComponent<Rotation>(8, 
+        ecs::EComponentStorage::SparseSet, true), std::invalid_argument);
+
+    // enough entities to span several words of the enable masks
+    constexpr size_t numEntities = 150;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position, Velocity>(numEntities, entities);
+
+    ecs::EntityHandle firstEntity = m_world->GetEntity(entities[0]);
+    const ecs::archetype_id archetypeID = firstEntity.archetypeID();
+    EXPECT_TRUE(firstEntity.IsComponentEnabled<Velocity>());
+    EXPECT_TRUE(firstEntity.IsComponentEnabled<Position>()) << "Components which are not enableable are always enabled";
+    ASSERT_THROW(firstEntity.SetComponentEnabled<Position>(false), std::logic_error);
+    ASSERT_THROW(firstEntity.SetComponentEnabled<Rotation>(false), std::out_of_range);
+
+    size_t numDisabled = 0;
+    for (size_t i = 0; i < numEntities; i += 3)
+    {
+        m_world->GetEntity(entities[i]).SetComponentEnabled<Velocity>(false);
+        ++numDisabled;
+    }
+
+    EXPECT_FALSE(firstEntity.IsComponentEnabled<Velocity>());
+    EXPECT_EQ(firstEntity.archetypeID(), archetypeID) << "Disabling a component should not move the entity";
+    EXPECT_NE(firstEntity.FindComponent<Velocity>(), nullptr) << "Disabled components can still be accessed";
+    EXPECT_EQ((CountEntities<Position, Velocity>()), numEntities - numDisabled);
+    EXPECT_EQ(CountEntities<Position>(), numEntities);
+
+    ecs::query<Velocity>::MakeQuery(m_world).forEach([&](ecs::EntityHandle entity, Velocity& velocity)
+    {
+        EXPECT_TRUE(entity.IsComponentEnabled<Velocity>());
+    });
+
+    // the enabled state follows the entity when it changes archetype or row
+    firstEntity.AddComponent<Rotation>();
+    EXPECT_FALSE(firstEntity.IsComponentEnabled<Velocity>());
+    m_world->DestroyEntity(entities[1]);
+    for (size_t i = 2; i < numEntities; ++i)
+    {
+        EXPECT_EQ(m_world->GetEntity(entities[i]).IsComponentEnabled<Velocity>(), i % 3 != 0);
+    }
+
+    firstEntity.SetComponentEnabled<Velocity>(true);
+    EXPECT_EQ((CountEntities<Position, Velocity>()), numEntities - numDisabled);
+
+    // enableable tags only get an enable mask
+    firstEntity.AddComponent<Frozen>();
+    EXPECT_EQ(CountEntities<Frozen>(), 1u);
+    firstEntity.SetComponentEnabled<Frozen>(false);
+    EXPECT_EQ(CountEntities<Frozen>(), 0u);
+}
+
+TEST_F(TestECSWorld, TestCompact)
+{
+    std::shared_ptr<ecs::ArchetypesRegistry> archetypesRegistry = m_world->GetArchetypesRegistry();
+
+    // a spike of entities, most of which are destroyed afterwards
+    constexpr size_t numEntities = 5000;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position, Velocity>(numEntities, entities, 
+        [](size_t index, Position& position, Velocity& velocity) { position.x = static_cast<ecs::real_t>(index); });
+    m_world->DestroyEntities(std::span<const ecs::entity_id>(entities).subspan(10));
+
+    ecs::EntityHandle entity = m_world->GetEntity(entities[0]);
+    const ecs::archetype_id archetypeID = entity.archetypeID();
+    const size_t peakCapacity = archetypesRegistry->GetCapacityForArchetype(archetypeID);
+
+    // leave an archetype without entities behind
+    entity.AddComponent<Rotation>();
+    entity.RemoveComponent<Rotation>();
+    const size_t numArchetypes = archetypesRegistry->GetNumArchetypes();
+
+    // one archetype per call
+    EXPECT_FALSE(m_world->Compact(1));
+    EXPECT_TRUE(m_world->Compact(1));
+    EXPECT_EQ(archetypesRegistry->GetNumArchetypes(), numArchetypes - 1) << "Empty archetypes should be retired";
+    EXPECT_LT(archetypesRegistry->GetCapacityForArchetype(archetypeID), peakCapacity);
+    EXPECT_GE(archetypesRegistry->GetCapacityForArchetype(archetypeID), 10u);
+    EXPECT_EQ(CountEntities<Rotation>(), 0u);
+    EXPECT_EQ((CountEntities<Position, Velocity>()), 10u);
+    for (size_t i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(m_world->GetEntity(entities[i]).GetComponent<Position>().x, static_cast<ecs::real_t>(i))
+            << "Compacting should not alter the remaining entities";
+    }
+
+    // retired archetypes are created again when needed
+    entity.AddComponent<Rotation>();
+    EXPECT_EQ(archetypesRegistry->GetNumArchetypes(), numArchetypes);
+    EXPECT_EQ(CountEntities<Rotation>(), 1u);
+    EXPECT_EQ(entity.GetComponent<Position>().x, 0.0f);
+    entity.RemoveComponent<Rotation>();
+    EXPECT_EQ(m_world->GetEntity(entities[0]).archetypeID(), archetypeID);
+}
+
+TEST_F(TestECSWorld, TestSoAComponents)
+{
+    static_assert(ecs::is_soa_component_v<soa::Body> && !ecs::is_soa_component_v<Position>);
+
+    constexpr size_t numEntities = 100;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position, soa::Body>(numEntities, entities, 
+        [](size_t index, Position& position, ecs::soa_ref<soa::Body> body) 
+        { 
+            EXPECT_EQ(body.get<&soa::Body::x>(), 1.0f) << "Fields should start from their default value";
+            EXPECT_EQ(body.get<&soa::Body::group>(), 'a');
+            body.get<&soa::Body::mass>() = static_cast<double>(index);
+        });
+
+    // each field is a packed array of its own
+    ecs::soa_ref<soa::Body> first = m_world->GetEntity(entities[0]).GetComponent<soa::Body>();
+    ecs::soa_ref<soa::Body> second = m_world->GetEntity(entities[1]).GetComponent<soa::Body>();
+    EXPECT_EQ(&second.get<&soa::Body::x>(), &first.get<&soa::Body::x>() + 1);
+    EXPECT_EQ(&second.get<&soa::Body::mass>(), &first.get<&soa::Body::mass>() + 1);
+    EXPECT_EQ(&second.field<2>(), &first.field<2>() + 1);
+
+    size_t numVisited = 0;
+    ecs::query<soa::Body>::MakeQuery(m_world).forEach(
+        [&numVisited](ecs::EntityHandle entity, ecs::soa_ref<soa::Body> body) 
+        { 
+            body.get<&soa::Body::x>() = static_cast<ecs::real_t>(body.get<&soa::Body::mass>()) * 2.0f;
+            ++numVisited;
+        });
+    EXPECT_EQ(numVisited, numEntities);
+
+    // fields follow the entity when it changes archetype
+    ecs::EntityHandle entity = m_world->GetEntity(entities[10]);
+    entity.AddComponent<Rotation>();
+    entity.RemoveComponent<Position>();
+    const soa::Body body = entity.GetComponent<soa::Body>().load();
+    EXPECT_EQ(body.x, 20.0f);
+    EXPECT_EQ(body.mass, 10.0);
+    EXPECT_EQ(body.group, 'a');
+    EXPECT_EQ(m_world->GetEntity(entities[99]).GetComponent<soa::Body>().load().x, 198.0f);
+
+    entity.GetComponent<soa::Body>().store(soa::Body{ {}, 5.0f, 6.0, 'z' });
+    EXPECT_EQ(entity.GetComponent<soa::Body>().get<&soa::Body::group>(), 'z');
+    EXPECT_EQ(m_world->GetArchetypesRegistry()->GetComponent<soa::Body>(entity.id()).get<&soa::Body::mass>(), 6.0);
+
+    EXPECT_THROW(m_world->GetComponentsRegistry()->RegisterComponent<soa::Body>(8, ecs::EComponentStorage::SparseSet),
+        std::invalid_argument);
+}
+
+TEST_F(TestECSWorld, TestForEachWithoutEntityHandle)
+{
+    constexpr size_t numEntities = 300;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position, Velocity>(numEntities, entities, 
+        [](size_t index, Position& position, Velocity& velocity) { velocity.x = static_cast<ecs::real_t>(index); });
+
+    ecs::query<Position, Velocity>::MakeQuery(m_world).forEach(
+        [](Position& position, const Velocity& velocity) { position.x += velocity.x; });
+
+    // any callable works, including the ones which can't be copied
+    std::unique_ptr<ecs::real_t> sum = std::make_unique<ecs::real_t>(0.0f);
+    ecs::query<Position>::MakeQuery(m_world).forEach(
+        [sum = std::move(sum)](Position& position) mutable { *sum += position.x; });
+
+    for (size_t i = 0; i < numEntities; ++i)
+    {
+        EXPECT_EQ(m_world->GetEntity(entities[i]).GetComponent<Position>().x, static_cast<ecs::real_t>(i));
+    }
+}
+
+TEST_F(TestECSWorld, TestForEachChunk)
+{
+    struct Sleeping : public ecs::IComponent {};
+    m_world->GetComponentsRegistry()->RegisterComponent<Velocity>(8, ecs::EComponentStorage::Archetype, true);
+    m_world->GetComponentsRegistry()->RegisterComponent<Sleeping>(8, ecs::EComponentStorage::SparseSet);
+
+    // enough entities to fill several chunks
+    constexpr size_t numEntities = 5000;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position, Velocity>(numEntities, entities, 
+        [](size_t index, Position& position, Velocity& velocity) { velocity.x = static_cast<ecs::real_t>(index); });
+
+    size_t numRuns = 0;
+    size_t numVisited = 0;
+    ecs::query<Position, Velocity>::MakeQuery(m_world).forEachChunk(
+        [&](std::span<const ecs::entity_id> chunkEntities, std::span<Position> positions, std::span<Velocity> velocities)
+        {
+            ASSERT_EQ(positions.size(), chunkEntities.size());
+            ASSERT_EQ(velocities.size(), chunkEntities.size());
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                positions[i].x += velocities[i].x;
+            }
+
+            ++numRuns;
+            numVisited += chunkEntities.size();
+        });
+    EXPECT_EQ(numVisited, numEntities);
+    EXPECT_GT(numRuns, 1u) << "Entities should span several chunks";
+    for (size_t i = 0; i < numEntities; i += 97)
+    {
+        EXPECT_EQ(m_world->GetEntity(entities[i]).GetComponent<Position>().x, static_cast<ecs::real_t>(i));
+    }
+
+    // disabled components split chunks in runs of enabled rows
+    m_world->GetEntity(entities[1]).SetComponentEnabled<Velocity>(false);
+    m_world->GetEntity(entities[2]).SetComponentEnabled<Velocity>(false);
+    std::vector<ecs::entity_id> visitedEntities;
+    ecs::query<Velocity>::MakeQuery(m_world).forEachChunk(
+        [&](std::span<const ecs::entity_id> chunkEntities, std::span<Velocity> velocities)
+        {
+            visitedEntities.insert(visitedEntities.end(), chunkEntities.begin(), chunkEntities.end());
+        });
+    ASSERT_EQ(visitedEntities.size(), numEntities - 2);
+    EXPECT_EQ(visitedEntities[0], entities[0]);
+    EXPECT_EQ(visitedEntities[1], entities[3]);
+
+    // SoA components come as a span per field
+    const ecs::entity_id bodyEntity = m_world->CreateEntity<soa::Body>();
+    m_world->CreateEntity<soa::Body>();
+    ecs::query<soa::Body>::MakeQuery(m_world).forEachChunk(
+        [](std::span<const ecs::entity_id> chunkEntities, ecs::soa_span<soa::Body> bodies)
+        {
+            ASSERT_EQ(bodies.size(), 2u);
+            std::span<double> masses = bodies.get<&soa::Body::mass>();
+            for (size_t i = 0; i < masses.size(); ++i)
+            {
+                masses[i] = static_cast<double>(i) + 10.0;
+            }
+            EXPECT_EQ(bodies[1].get<&soa::Body::x>(), 1.0f);
+        });
+    EXPECT_EQ(m_world->GetEntity(bodyEntity).GetComponent<soa::Body>().get<&soa::Body::mass>(), 10.0);
+
+    // sparse components are not contiguous
+    const auto ignoreChunk = [](std::span<const ecs::entity_id>, std::span<Position>, std::span<Sleeping>) {};
+    EXPECT_THROW((ecs::query<Position, Sleeping>::MakeQuery(m_world).forEachChunk(ignoreChunk)), std::logic_error);
+}
+
+TEST_F(TestECSWorld, TestQueryFilters)
+{
+    struct Frozen : public ecs::IComponent {};
+    struct Marked : public ecs::IComponent {};
+    m_world->GetComponentsRegistry()->RegisterComponent<Velocity>(8, ecs::EComponentStorage::Archetype, true);
+    m_world->GetComponentsRegistry()->RegisterComponent<Marked>(8, ecs::EComponentStorage::SparseSet);
+
+    const ecs::entity_id moving = m_world->CreateEntity<Position, Velocity>();
+    const ecs::entity_id still = m_world->CreateEntity<Position>();
+    const ecs::entity_id frozen = m_world->CreateEntity<Position, Velocity, Frozen>();
+    m_world->GetEntity(moving).GetComponent<Velocity>().x = 2.0f;
+
+    // With filters without fetching, Without excludes whole archetypes
+    std::vector<ecs::entity_id> visited;
+    ecs::query<Position, ecs::With<Velocity>, ecs::Without<Frozen>>::MakeQuery(m_world).forEach(
+        [&](ecs::EntityHandle entity, Position& position) { visited.push_back(entity.id()); });
+    EXPECT_EQ(visited, std::vector<ecs::entity_id>{moving});
+
+    // archetypes created after the query was first run are matched as well
+    const ecs::entity_id rotating = m_world->CreateEntity<Position, Velocity, Rotation>();
+    m_world->CreateEntity<Position, Velocity, Rotation, Frozen>();
+    visited.clear();
+    ecs::query<Position, ecs::With<Velocity>, ecs::Without<Frozen>>::MakeQuery(m_world).forEach(
+        [&](ecs::EntityHandle entity, Position& position) { visited.push_back(entity.id()); });
+    EXPECT_EQ(visited, (std::vector<ecs::entity_id>{moving, rotating}));
+
+    // optional components are null when missing or disabled
+    m_world->GetEntity(rotating).SetComponentEnabled<Velocity>(false);
+    std::map<ecs::entity_id, ecs::real_t> velocities;
+    ecs::query<Position, ecs::Optional<Velocity>>::MakeQuery(m_world).forEach(
+        [&](ecs::EntityHandle entity, Position& position, Velocity* velocity) 
+        { 
+            velocities[entity.id()] = velocity != nullptr ? velocity->x : -1.0f; 
+        });
+    ASSERT_EQ(velocities.size(), 5u);
+    EXPECT_EQ(velocities[moving], 2.0f);
+    EXPECT_EQ(velocities[still], -1.0f);
+    EXPECT_EQ(velocities[frozen], 0.0f);
+    EXPECT_EQ(velocities[rotating], -1.0f);
+
+    // sparse components are filtered row by row
+    m_world->GetEntity(still).AddComponent<Marked>();
+    size_t numMarked = 0;
+    size_t numUnmarked = 0;
+    ecs::query<Position, ecs::Optional<Marked>>::MakeQuery(m_world).forEach(
+        [&](Position& position, Marked* marked) { marked != nullptr ? ++numMarked : ++numUnmarked; });
+    EXPECT_EQ(numMarked, 1u);
+    EXPECT_EQ(numUnmarked, 4u);
+    size_t numWithMarked = 0;
+    ecs::query<Position, ecs::With<Marked>>::MakeQuery(m_world).forEach([&](Position& position) { ++numWithMarked; });
+    EXPECT_EQ(numWithMarked, 1u);
+    size_t numWithoutMarked = 0;
+    ecs::query<Position, ecs::Without<Marked>>::MakeQuery(m_world).forEach([&](Position& position) { ++numWithoutMarked; });
+    EXPECT_EQ(numWithoutMarked, 4u);
+
+    // chunks of archetypes missing optional components come with empty spans
+    size_t numVisited = 0;
+    ecs::query<Position, ecs::Optional<Rotation>, ecs::Without<Frozen>>::MakeQuery(m_world).forEachChunk(
+        [&](std::span<const ecs::entity_id> chunkEntities, std::span<Position> positions, std::span<Rotation> rotations)
+        {
+            EXPECT_TRUE(rotations.empty() || rotations.size() == chunkEntities.size());
+            EXPECT_EQ(rotations.empty(), chunkEntities[0] != rotating);
+            numVisited += chunkEntities.size();
+        });
+    EXPECT_EQ(numVisited, 3u);
+}
+
+TEST_F(TestECSWorld, TestChangeFilters)
+{
+    class ChangedPositionsSystem : public ecs::ISystem
+    {
+    public:
+        void Update(std::weak_ptr<ecs::World> world, ecs::real_t deltaTime) override
+        {
+            numChanged = 0;
+            ecs::query<const Position, ecs::Changed<Position>>::MakeQuery(world).forEach(
+                [this](const Position& position) { ++numChanged; });
+        }
+
+        size_t numChanged = 0;
+    };
+
+    constexpr size_t numEntities = 5000;
+    std::vector<ecs::entity_id> entities(numEntities);
+    m_world->CreateEntities<Position>(numEntities, entities);
+
+    // systems see all the changes made since their previous run, and only those
+    std::shared_ptr<ChangedPositionsSystem> system = m_world->AddSystem<ChangedPositionsSystem>();
+    m_world->Update(0.0f);
+    EXPECT_EQ(system->numChanged, numEntities);
+    m_world->Update(0.0f);
+    EXPECT_EQ(system->numChanged, 0u) << "Reading components should not mark them as changed";
+
+    // changes are tracked per chunk
+    m_world->GetEntity(entities[0]).GetComponent<Position>().x = 1.0f;
+    m_world->Update(0.0f);
+    EXPECT_GT(system->numChanged, 0u);
+    EXPECT_LT(system->numChanged, numEntities);
+    m_world->Update(0.0f);
+    EXPECT_EQ(system->numChanged, 0u);
+
+    // outside of systems, queries compare with an explicit last run tick
+    std::shared_ptr<ecs::ArchetypesRegistry> registry = m_world->GetArchetypesRegistry();
+    registry->SetLastRunTick(registry->AdvanceChangeTick());
+    ecs::query<Position>::MakeQuery(m_world).forEach([](Position& position) { position.x += 1.0f; });
+    EXPECT_EQ((CountEntities<const Position, ecs::Changed<Position>>()), numEntities) 
+        << "Fetching components as non-const should mark them as changed";
+
+    // added components are tracked in the chunks their entities move to
+    registry->SetLastRunTick(registry->AdvanceChangeTick());
+    EXPECT_EQ((CountEntities<const Position, ecs::Added<Position>>()), 0u);
+    m_world->GetEntity(entities[1]).AddComponent<Velocity>();
+    EXPECT_EQ((CountEntities<const Position, ecs::Added<Velocity>>()), 1u);
+    EXPECT_EQ((CountEntities<const Position, ecs::Added<Position>>()), 0u) 
+        << "Moved components should keep their ticks";
+    size_t numChunks = 0;
+    ecs::query<const Position, ecs::Changed<Position>>::MakeQuery(m_world).forEachChunk(
+        [&](std::span<const ecs::entity_id> chunkEntities, std::span<const Position> positions) { ++numChunks; });
+    EXPECT_EQ(numChunks, 0u);
+}